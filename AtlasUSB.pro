@@ -42,7 +42,21 @@ SOURCES += \
     src/serialdialog.cpp \
     thirdparty/qcustomplot.cpp \
     src/atlasusbreceiver.cpp \
-    src/loggingframe.cpp
+    src/loggingframe.cpp \
+    src/sleepscheduler.cpp \
+    src/acquisitiongroup.cpp \
+    src/logwriter.cpp \
+    src/binlog.cpp \
+    src/logmanifest.cpp \
+    src/logstore.cpp \
+    src/logrollup.cpp \
+    src/readingjournal.cpp \
+    src/lineformatter.cpp \
+    src/readingsource.cpp \
+    src/replaysource.cpp \
+    src/serialcapture.cpp \
+    src/ringseries.cpp \
+    src/realtimegraph.cpp
 
 HEADERS += \
     src/mainwindow.h \
@@ -54,7 +68,23 @@ HEADERS += \
     src/serialdialog.h \
     thirdparty/qcustomplot.h \
     src/atlasusbreceiver.h \
-    src/loggingframe.h
+    src/loggingframe.h \
+    src/sleepscheduler.h \
+    src/acquisitiongroup.h \
+    src/atlasreading.h \
+    src/logwriter.h \
+    src/spscqueue.h \
+    src/binlog.h \
+    src/logmanifest.h \
+    src/logstore.h \
+    src/logrollup.h \
+    src/readingjournal.h \
+    src/lineformatter.h \
+    src/readingsource.h \
+    src/replaysource.h \
+    src/serialcapture.h \
+    src/ringseries.h \
+    src/realtimegraph.h
 
 FORMS += \
     src/mainwindow.ui \
@@ -0,0 +1,175 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "acquisitiongroup.h"
+#include <QDateTime>
+
+AcquisitionGroup::AcquisitionGroup(QObject *parent) : QObject(parent)
+{
+    qRegisterMetaType<AtlasReadingRow>("AtlasReadingRow");
+
+    tickTimer = new QTimer(this);
+    tickTimer->setTimerType(Qt::PreciseTimer);
+    connect(tickTimer, SIGNAL(timeout()),
+            this, SLOT(tick()));
+
+    windowTimer = new QTimer(this);
+    windowTimer->setSingleShot(true);
+    connect(windowTimer, SIGNAL(timeout()),
+            this, SLOT(closeRow()));
+}
+
+AcquisitionGroup::~AcquisitionGroup()
+{
+
+}
+
+/**
+ * @brief Add a stamp to the group.
+ *
+ * @param stamp
+ * @return stampId: index of the stamp in the rows emitted by rowReady()
+ */
+int AcquisitionGroup::addStamp(QAtlasUSB *stamp)
+{
+    stamps.append(stamp);
+    connect(stamp, SIGNAL(measRead()),
+            this, SLOT(onMeasRead()));
+    return stamps.size() - 1;
+}
+
+int AcquisitionGroup::stampCount() const
+{
+    return stamps.size();
+}
+
+QAtlasUSB *AcquisitionGroup::getStamp(int stampId) const
+{
+    return stamps.at(stampId);
+}
+
+/**
+ * @brief Start synchronized acquisition.
+ *
+ * Every intervalMs all stamps get their "R" in one go,
+ * so the readings of one tick are taken within a few ms of each other.
+ */
+void AcquisitionGroup::start()
+{
+    if (stamps.isEmpty()) return;
+    tickTimer->start(intervalMs);
+    tick();
+}
+
+void AcquisitionGroup::stop()
+{
+    tickTimer->stop();
+    closeRow();
+}
+
+/**
+ * @brief Fire "R" to all stamps and open a new row with the common acquisition time.
+ */
+void AcquisitionGroup::tick()
+{
+    // a stamp that did not answer before the next tick is reported as missing
+    if (rowOpen) closeRow();
+
+    row.fill(AtlasReading(), stamps.size());
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (int i = 0; i < row.size(); ++i) {
+        row[i].timeMs = now;
+        row[i].deltaMs = -1;    // no reading (yet)
+        row[i].stampId = quint16(i);
+    }
+    pending = stamps.size();
+    rowOpen = true;
+
+    tickClock.start();
+    for (int i = 0; i < stamps.size(); ++i) {
+        emit cmdAvailable(i, stamps.at(i)->readpHORP());
+    }
+    windowTimer->start(windowMs);
+}
+
+/**
+ * @brief Store the reading of the stamp that sent measRead() with its arrival delta.
+ */
+void AcquisitionGroup::onMeasRead()
+{
+    if (!rowOpen) return;
+
+    int id = stamps.indexOf(qobject_cast<QAtlasUSB*>(sender()));
+    if (id < 0 || row.at(id).deltaMs >= 0) return;   // unknown stamp or second reading in this tick
+
+    AtlasReading &r = row[id];
+    r.deltaMs = qint32(tickClock.elapsed());
+    r.channel = quint16(stamps.at(id)->getChannel());
+    r.value = stamps.at(id)->getCurrentValue();
+
+    if (--pending == 0) closeRow();
+}
+
+/**
+ * @brief Emit the row of the current tick, complete or at the end of the window.
+ */
+void AcquisitionGroup::closeRow()
+{
+    if (!rowOpen) return;
+
+    windowTimer->stop();
+    rowOpen = false;
+    emit rowReady(row);
+}
+
+// Getters and Setters
+int AcquisitionGroup::getIntervalMs() const
+{
+    return intervalMs;
+}
+
+void AcquisitionGroup::setIntervalMs(int value)
+{
+    intervalMs = value;
+    if (tickTimer->isActive()) tickTimer->start(intervalMs);
+}
+
+int AcquisitionGroup::getWindowMs() const
+{
+    return windowMs;
+}
+
+void AcquisitionGroup::setWindowMs(int value)
+{
+    windowMs = value;
+}
+
+bool AcquisitionGroup::isActive() const
+{
+    return tickTimer->isActive();
+}
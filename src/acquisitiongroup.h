@@ -0,0 +1,88 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef ACQUISITIONGROUP_H
+#define ACQUISITIONGROUP_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QList>
+
+#include "qatlasusb.h"
+#include "atlasreading.h"
+
+class AcquisitionGroup : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AcquisitionGroup(QObject *parent = 0);
+    ~AcquisitionGroup();
+
+    int addStamp(QAtlasUSB *stamp);
+    int stampCount() const;
+    QAtlasUSB* getStamp(int stampId) const;
+
+// getters
+    int getIntervalMs() const;
+    int getWindowMs() const;
+    bool isActive() const;
+
+// setters
+    void setIntervalMs(int value);
+    void setWindowMs(int value);
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void cmdAvailable(int stampId, QByteArray newCommand);
+    void rowReady(const AtlasReadingRow &row);
+
+private slots:
+    void tick();
+    void onMeasRead();
+    void closeRow();
+
+private:
+    QList<QAtlasUSB*> stamps;
+    QTimer* tickTimer;
+    QTimer* windowTimer;
+
+    QElapsedTimer tickClock;   /**< time since the "R" of the current tick */
+    AtlasReadingRow row;
+    int pending = 0;           /**< stamps that did not answer this tick yet */
+    bool rowOpen = false;
+
+    int intervalMs = 1000;     /**< acquisition period, >= conversion time */
+    int windowMs = 900;        /**< max. time to wait for all stamps of one tick */
+};
+
+#endif // ACQUISITIONGROUP_H
@@ -0,0 +1,57 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef ATLASREADING_H
+#define ATLASREADING_H
+
+#include <QtGlobal>
+#include <QMetaType>
+#include <QVector>
+
+/** @brief One measurement value of one EZO stamp.
+ *
+ * Plain value type, cheap to copy between threads and
+ * written as-is to the binary log formats.
+*/
+struct AtlasReading {
+    enum Channel { chUnknown = 0, chpH, chORP, chEC, chDO, chTemp };
+
+    qint64  timeMs = 0;     /**< acquisition time, ms since epoch */
+    qint32  deltaMs = 0;    /**< arrival of the reading relative to timeMs */
+    quint16 stampId = 0;    /**< index of the stamp in the acquisition group */
+    quint16 channel = chUnknown; /**< probe type, see AtlasReading::Channel */
+    double  value = 0.0;    /**< measurement value in the unit of the channel */
+    };
+
+/** @brief One row of readings of a group of stamps sharing one acquisition time. */
+typedef QVector<AtlasReading> AtlasReadingRow;
+
+Q_DECLARE_METATYPE(AtlasReading)
+Q_DECLARE_METATYPE(AtlasReadingRow)
+
+#endif // ATLASREADING_H
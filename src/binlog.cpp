@@ -0,0 +1,349 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "binlog.h"
+#include <QDateTime>
+#include <cstring>
+#include <limits>
+
+static_assert(sizeof(BinLogHeader) == 256, "binary log header must be 256 bytes");
+static_assert(sizeof(BinLogBlockHeader) == 16, "binary log block header must be 16 bytes");
+
+//----------------------------------------------------------------
+BinLogBlock::BinLogBlock(const uchar *base, int capacity) :
+    base(base),
+    capacity(capacity)
+{
+
+}
+
+int BinLogBlock::count() const
+{
+    if (!base) return 0;
+    return qMin(int(reinterpret_cast<const BinLogBlockHeader*>(base)->count), capacity);
+}
+
+qint64 BinLogBlock::firstTimeMs() const
+{
+    return base ? reinterpret_cast<const BinLogBlockHeader*>(base)->firstTimeMs : 0;
+}
+
+qint64 BinLogBlock::lastTimeMs() const
+{
+    return (count() > 0) ? timeMs(count()-1) : firstTimeMs();
+}
+
+/**
+ * @brief Time of record i: the block time plus its delta.
+ */
+qint64 BinLogBlock::timeMs(int i) const
+{
+    return firstTimeMs() + offsets()[i];
+}
+
+const quint32 *BinLogBlock::offsets() const
+{
+    return reinterpret_cast<const quint32*>(base + sizeof(BinLogBlockHeader));
+}
+
+/**
+ * @brief Values of column c, count() valid entries.
+ */
+const double *BinLogBlock::column(int c) const
+{
+    qint64 valuesOffset = sizeof(BinLogBlockHeader) + ((4*qint64(capacity) + 7) & ~qint64(7));
+    return reinterpret_cast<const double*>(base + valuesOffset) + qint64(c)*capacity;
+}
+
+//----------------------------------------------------------------
+BinLogWriter::BinLogWriter()
+{
+
+}
+
+/**
+ * @brief Number of records that fit in one block.
+ */
+int BinLogWriter::capacityFor(int blockSize, int columnCount)
+{
+    return (blockSize - int(sizeof(BinLogBlockHeader)) - 4) / (4 + 8*columnCount);
+}
+
+/**
+ * @brief Write the file header; the file must be open for writing and empty.
+ *
+ * @param file
+ * @param columns one column per stamp, at most BinLogHeader::kMaxColumns
+ * @param blockSize bytes per block
+ * @return false if the layout is invalid or the header cannot be written
+ */
+bool BinLogWriter::open(QFile *file, const QVector<BinLogColumn> &columns, int blockSize)
+{
+    if (columns.isEmpty() || columns.size() > BinLogHeader::kMaxColumns) return false;
+    blockSize = (blockSize + 7) & ~7;
+    if (capacityFor(blockSize, columns.size()) < 1) return false;
+
+    this->file = file;
+    this->blockSize = blockSize;
+    this->columns = columns.size();
+    capacity = capacityFor(blockSize, this->columns);
+
+    BinLogHeader hdr = BinLogHeader();
+    std::memcpy(hdr.magic, "ATLB", 4);
+    hdr.version = 1;
+    hdr.columnCount = quint16(this->columns);
+    hdr.blockSize = quint32(blockSize);
+    hdr.capacity = quint32(capacity);
+    hdr.createdMs = QDateTime::currentMSecsSinceEpoch();
+    for (int c = 0; c < this->columns; ++c) hdr.columns[c] = columns.at(c);
+
+    file->seek(0);
+    if (file->write(reinterpret_cast<const char*>(&hdr), sizeof(hdr)) != qint64(sizeof(hdr))) return false;
+
+    blockPos = qint64(sizeof(BinLogHeader)) - blockSize;   // first startBlock() moves to the first block
+    count = 0;
+    committed = 0;
+    block.clear();
+    return true;
+}
+
+int BinLogWriter::columnCount() const
+{
+    return columns;
+}
+
+qint64 BinLogWriter::valuesOffset() const
+{
+    return sizeof(BinLogBlockHeader) + ((4*qint64(capacity) + 7) & ~qint64(7));
+}
+
+void BinLogWriter::startBlock(qint64 timeMs)
+{
+    if (!block.isEmpty()) commit();
+
+    blockPos += blockSize;
+    block.fill('\0', blockSize);
+    BinLogBlockHeader *bh = reinterpret_cast<BinLogBlockHeader*>(block.data());
+    std::memcpy(bh->magic, "BLK1", 4);
+    bh->count = 0;
+    bh->firstTimeMs = timeMs;
+    firstTimeMs = timeMs;
+    count = 0;
+    committed = 0;
+}
+
+/**
+ * @brief Append one record; values holds columnCount() doubles.
+ *
+ * A new block is started when the block is full, or when the time delta
+ * does not fit in 32 bits (time going backwards or a gap of > 49 days).
+ */
+void BinLogWriter::append(qint64 timeMs, const double *values)
+{
+    if (!file) return;
+
+    qint64 delta = timeMs - firstTimeMs;
+    if (block.isEmpty() || count >= capacity || delta < 0
+            || delta > qint64(std::numeric_limits<quint32>::max())) {
+        startBlock(timeMs);
+        delta = 0;
+    }
+
+    char *b = block.data();
+    reinterpret_cast<quint32*>(b + sizeof(BinLogBlockHeader))[count] = quint32(delta);
+    double *v = reinterpret_cast<double*>(b + valuesOffset());
+    for (int c = 0; c < columns; ++c) v[qint64(c)*capacity + count] = values[c];
+    ++count;
+    reinterpret_cast<BinLogBlockHeader*>(b)->count = quint32(count);
+}
+
+/**
+ * @brief Write the records appended since the last commit, and the block header.
+ *
+ * The block header (with the record count) is written last,
+ * so a reader never sees a count that covers unwritten records.
+ */
+void BinLogWriter::commit()
+{
+    if (!file || block.isEmpty()) return;
+
+    if (committed == 0) {
+        // whole block the first time: the file always has a multiple of blockSize bytes
+        file->seek(blockPos);
+        file->write(block);
+    } else if (count > committed) {
+        const char *b = block.constData();
+        qint64 pos = sizeof(BinLogBlockHeader) + 4*qint64(committed);
+        file->seek(blockPos + pos);
+        file->write(b + pos, 4*qint64(count - committed));
+        for (int c = 0; c < columns; ++c) {
+            pos = valuesOffset() + 8*(qint64(c)*capacity + committed);
+            file->seek(blockPos + pos);
+            file->write(b + pos, 8*qint64(count - committed));
+        }
+        file->seek(blockPos);
+        file->write(b, sizeof(BinLogBlockHeader));
+    }
+    committed = count;
+}
+
+//----------------------------------------------------------------
+BinLogReader::BinLogReader() :
+    hdr(BinLogHeader())
+{
+
+}
+
+BinLogReader::~BinLogReader()
+{
+    close();
+}
+
+/**
+ * @brief Map a binary log into memory; the blocks are used in place.
+ *
+ * A last block that was not completely written is ignored.
+ */
+bool BinLogReader::open(const QString &fileName)
+{
+    close();
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+    size = file.size();
+    if (size < qint64(sizeof(BinLogHeader))) {
+        error = "File too small for a binary log";
+        file.close();
+        return false;
+    }
+    map = file.map(0, size);
+    if (!map) {
+        error = file.errorString();
+        file.close();
+        return false;
+    }
+    data = map;
+    return checkHeader();
+}
+
+/**
+ * @brief Use a binary log held in memory, e.g. an uncompressed ".qz" segment.
+ */
+bool BinLogReader::openBuffer(const QByteArray &data)
+{
+    close();
+    buffer = data;
+    size = buffer.size();
+    if (size < qint64(sizeof(BinLogHeader))) {
+        error = "File too small for a binary log";
+        close();
+        return false;
+    }
+    this->data = reinterpret_cast<const uchar*>(buffer.constData());
+    return checkHeader();
+}
+
+bool BinLogReader::checkHeader()
+{
+    std::memcpy(&hdr, data, sizeof(hdr));
+    if (std::memcmp(hdr.magic, "ATLB", 4) != 0 || hdr.version != 1
+            || hdr.columnCount == 0 || hdr.columnCount > BinLogHeader::kMaxColumns
+            || hdr.blockSize == 0 || hdr.blockSize % 8 != 0
+            || int(hdr.capacity) != BinLogWriter::capacityFor(int(hdr.blockSize), hdr.columnCount)) {
+        error = "Not a binary log file";
+        close();
+        return false;
+    }
+    error.clear();
+    return true;
+}
+
+void BinLogReader::close()
+{
+    if (map) file.unmap(map);
+    map = 0;
+    data = 0;
+    buffer.clear();
+    size = 0;
+    if (file.isOpen()) file.close();
+}
+
+bool BinLogReader::isOpen() const
+{
+    return data != 0;
+}
+
+QString BinLogReader::errorString() const
+{
+    return error;
+}
+
+const BinLogHeader &BinLogReader::header() const
+{
+    return hdr;
+}
+
+int BinLogReader::columnCount() const
+{
+    return hdr.columnCount;
+}
+
+BinLogColumn BinLogReader::column(int c) const
+{
+    return hdr.columns[c];
+}
+
+int BinLogReader::blockCount() const
+{
+    if (!data) return 0;
+    return int((size - qint64(sizeof(BinLogHeader))) / hdr.blockSize);
+}
+
+BinLogBlock BinLogReader::block(int i) const
+{
+    return BinLogBlock(data + sizeof(BinLogHeader) + qint64(i)*hdr.blockSize, int(hdr.capacity));
+}
+
+qint64 BinLogReader::recordCount() const
+{
+    qint64 n = 0;
+    for (int i = 0; i < blockCount(); ++i) n += block(i).count();
+    return n;
+}
+
+/**
+ * @brief True if the file starts with the binary log magic.
+ */
+bool BinLogReader::isBinLog(const QString &fileName)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly)) return false;
+    return f.read(4) == "ATLB";
+}
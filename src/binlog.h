@@ -0,0 +1,164 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef BINLOG_H
+#define BINLOG_H
+
+#include <QFile>
+#include <QVector>
+#include <QByteArray>
+
+/*
+Binary log file layout (little endian, native double):
+
+File header     256 bytes, see BinLogHeader
+Block 0         blockSize bytes
+Block 1         ...
+
+Block           BinLogBlockHeader (16 bytes)
+                quint32 offsets[capacity]     ms since firstTimeMs of the block
+                (padding to 8 bytes)
+                double  column0[capacity]     one array per column, NaN if missing
+                double  column1[capacity]
+                ...
+
+All blocks have the same size and the same capacity, so column arrays are at
+fixed offsets and can be used in place from a memory mapped file.
+*/
+
+/** @brief One column of a binary log: the values of one stamp. */
+struct BinLogColumn {
+    quint16 stampId = 0;    /**< index of the stamp in the acquisition group */
+    quint16 channel = 0;    /**< probe type, see AtlasReading::Channel */
+    };
+
+/** @brief File header of a binary log. */
+struct BinLogHeader {
+    enum { kMaxColumns = 32 };
+
+    char    magic[4];       /**< "ATLB" */
+    quint16 version;        /**< 1 */
+    quint16 columnCount;
+    quint32 blockSize;      /**< bytes per block, multiple of 8 */
+    quint32 capacity;       /**< records per block */
+    qint64  createdMs;      /**< ms since epoch */
+    BinLogColumn columns[kMaxColumns];
+    char    reserved[256 - 24 - 4*kMaxColumns];
+    };
+
+/** @brief Header of one block of a binary log. */
+struct BinLogBlockHeader {
+    char    magic[4];       /**< "BLK1" */
+    quint32 count;          /**< valid records in this block */
+    qint64  firstTimeMs;    /**< ms since epoch of the first record */
+    };
+
+/** @brief Read-only view on one block of a memory mapped binary log, no data is copied. */
+class BinLogBlock
+{
+public:
+    BinLogBlock(const uchar *base = 0, int capacity = 0);
+
+    int count() const;
+    qint64 firstTimeMs() const;
+    qint64 lastTimeMs() const;
+    qint64 timeMs(int i) const;
+    const quint32 *offsets() const;
+    const double *column(int c) const;
+
+private:
+    const uchar *base;
+    int capacity;
+};
+
+/** @brief Writes records into the blocks of a binary log file.
+ *
+ * Only the part of the current block that changed since the last commit() is written.
+*/
+class BinLogWriter
+{
+public:
+    BinLogWriter();
+
+    bool open(QFile *file, const QVector<BinLogColumn> &columns, int blockSize = 16384);
+    void append(qint64 timeMs, const double *values);
+    void commit();
+
+    int columnCount() const;
+    static int capacityFor(int blockSize, int columnCount);
+
+private:
+    void startBlock(qint64 timeMs);
+    qint64 valuesOffset() const;
+
+    QFile* file = 0;
+    QByteArray block;           /**< current block, kept in memory */
+    qint64 blockPos = 0;        /**< file offset of the current block */
+    int blockSize = 0;
+    int capacity = 0;
+    int columns = 0;
+    int count = 0;              /**< records in the current block */
+    int committed = 0;          /**< records of the current block already written */
+    qint64 firstTimeMs = 0;
+};
+
+/** @brief Memory mapped reader of a binary log file. */
+class BinLogReader
+{
+public:
+    BinLogReader();
+    ~BinLogReader();
+
+    bool open(const QString &fileName);
+    bool openBuffer(const QByteArray &data);
+    void close();
+    bool isOpen() const;
+    QString errorString() const;
+
+    const BinLogHeader &header() const;
+    int columnCount() const;
+    BinLogColumn column(int c) const;
+    int blockCount() const;
+    BinLogBlock block(int i) const;
+    qint64 recordCount() const;
+
+    static bool isBinLog(const QString &fileName);
+
+private:
+    bool checkHeader();
+
+    QFile file;
+    uchar* map = 0;
+    QByteArray buffer;          /**< contents of an uncompressed segment, used instead of map */
+    const uchar* data = 0;      /**< start of the file: map or buffer */
+    qint64 size = 0;
+    BinLogHeader hdr;
+    QString error;
+};
+
+#endif // BINLOG_H
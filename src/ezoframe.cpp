@@ -43,6 +43,14 @@ EZOFrame::EZOFrame(QWidget *parent) :
              this, SLOT(displayInfo()) );
     connect( stamp, SIGNAL(measRead()),
              this, SLOT(displayMeas()) );
+
+    scheduler = new SleepScheduler(stamp, this);
+    connect( scheduler, SIGNAL(cmdAvailable(QByteArray)),
+             this, SIGNAL(cmdAvailable(QByteArray)) );
+    connect( stamp, SIGNAL(measRead()),
+             scheduler, SLOT(sampleRead()) );
+    connect( scheduler, SIGNAL(stateChanged(int)),
+             this, SLOT(displayDutyCycle()) );
 }
 
 EZOFrame::~EZOFrame()
@@ -105,6 +113,9 @@ void EZOFrame::displayMeas()
     } else if (pt == "ORP") {
         dval = pr.currentORP;
         if (dval > -1021 && dval < 1021) ui->valueLabel->setText(QString::number(dval, 'f', 1 ) + " mV");
+    } else if (pt == "DO") {
+        dval = pr.currentDO;
+        if (dval >= 0 && dval < 100) ui->valueLabel->setText(QString::number(dval, 'f', 2 ) + " mg/L");
     }
 }
 
@@ -235,8 +246,62 @@ void EZOFrame::on_btnSleep_clicked()
  */
 void EZOFrame::on_cbAuto_clicked(bool checked)
 {
-    if (checked) stampTimer->start(1000);
-    else stampTimer->stop();
+    if (checked) {
+        scheduler->stop();
+        ui->cbDuty->setChecked(false);
+        stampTimer->start(1000);
+    } else {
+        stampTimer->stop();
+        ui->cbAuto->setChecked(false);
+    }
+}
+
+/**
+ * @brief EZOFrame::on_cbDuty_clicked
+ * @param checked
+ *
+ * starts duty cycling of the stamp: wake, settle, read N samples, sleep
+ * for stamps that are only sampled every few minutes
+ * AutoRead is switched off, both send "R" to the same stamp
+ */
+void EZOFrame::on_cbDuty_clicked(bool checked)
+{
+    if (checked) {
+        stampTimer->stop();
+        ui->cbAuto->setChecked(false);
+        scheduler->start();
+    }
+    else scheduler->stop();
+}
+
+/**
+ * @brief Hand the "R" commands of the stamp to a synchronized acquisition group, or take them back.
+ *
+ * While locked AutoRead and duty cycling are off and cannot be switched on,
+ * a second "R" or a sleeping stamp would break the common clock of the group.
+ */
+void EZOFrame::setReadLocked(bool locked)
+{
+    if (locked) {
+        on_cbAuto_clicked(false);
+        ui->cbDuty->setChecked(false);
+        scheduler->stop();
+    }
+    ui->cbAuto->setEnabled(!locked);
+    ui->cbDuty->setEnabled(!locked);
+}
+
+void EZOFrame::displayDutyCycle()
+{
+    if (!scheduler->isActive()) {
+        ui->statusLabel->setText("Duty cycle off");
+        return;
+    }
+    ui->statusLabel->setText(QString("Duty cycle: awake %1 s, asleep %2 s (%3 %), wake-up %4 ms")
+                             .arg(scheduler->getAwakeMs()/1000)
+                             .arg(scheduler->getAsleepMs()/1000)
+                             .arg(100.0*scheduler->getDutyRatio(), 0, 'f', 1)
+                             .arg(scheduler->getMeasuredWakeMs()));
 }
 
 /**
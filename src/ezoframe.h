@@ -33,6 +33,7 @@
 
 #include "atlasdialog.h"
 #include "qatlasusb.h"
+#include "sleepscheduler.h"
 
 namespace Ui {
 class EZOFrame;
@@ -48,12 +49,15 @@ public:
 
     QByteArray lastCmd;
     QAtlasUSB* stamp = new QAtlasUSB();  // wel even aanmaken !
+    SleepScheduler* scheduler;
 
 public slots:
         void on_btnReadMeas_clicked();
         void on_contCB_clicked(bool checked);
+        void on_cbAuto_clicked(bool checked);
         void on_btnInfo_clicked();
         void displayBaudrate();
+        void setReadLocked(bool locked);
 
 signals:
     void cmdAvailable(QByteArray newCommand);
@@ -79,7 +83,8 @@ private slots:
     void displayInfo();
     void displayMeas();
 
-    void on_cbAuto_clicked(bool checked);
+    void on_cbDuty_clicked(bool checked);
+    void displayDutyCycle();
 
     void on_btnI2CAddr_clicked();
 
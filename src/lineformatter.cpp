@@ -0,0 +1,183 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "lineformatter.h"
+#include <QDateTime>
+#include <QTimeZone>
+#include <cmath>
+#include <cstdio>
+
+LineFormatter::LineFormatter()
+{
+
+}
+
+/**
+ * @brief Append "unixTime, yyyy-MM-dd, hh:mm:ss[.zzz]" in local time.
+ */
+void LineFormatter::appendTimestamp(QByteArray &out, qint64 timeMs, bool millis)
+{
+    if (timeMs < validFromMs || timeMs >= validToMs) updateDay(timeMs);
+
+    char *p = buf + formatInt(buf, timeMs/1000);
+    *p++ = ','; *p++ = ' ';
+    for (int i = 0; i < 10; ++i) *p++ = date[i];
+    *p++ = ','; *p++ = ' ';
+
+    int ms = int(timeMs - dayStartMs);
+    int s = ms/1000;
+    *p++ = char('0' + s/36000);
+    *p++ = char('0' + s/3600%10);
+    *p++ = ':';
+    *p++ = char('0' + s%3600/600);
+    *p++ = char('0' + s%600/60);
+    *p++ = ':';
+    *p++ = char('0' + s%60/10);
+    *p++ = char('0' + s%10);
+    if (millis) {
+        *p++ = '.';
+        *p++ = char('0' + ms%1000/100);
+        *p++ = char('0' + ms%100/10);
+        *p++ = char('0' + ms%10);
+    }
+    out.append(buf, int(p - buf));
+}
+
+/**
+ * @brief Append value with the fixed number of decimals of its probe type.
+ */
+void LineFormatter::appendValue(QByteArray &out, double value, int channel)
+{
+    out.append(buf, formatFixed(buf, value, decimalsFor(channel)));
+}
+
+void LineFormatter::appendInt(QByteArray &out, qint64 value)
+{
+    out.append(buf, formatInt(buf, value));
+}
+
+/**
+ * @brief Decimals of the EZO(TM) readings: pH 0.001, ORP 0.1 mV, EC/DO 0.01, temperature 0.001 °C.
+ */
+int LineFormatter::decimalsFor(int channel)
+{
+    switch (channel) {
+    case AtlasReading::chORP:
+        return 1;
+    case AtlasReading::chEC:
+    case AtlasReading::chDO:
+        return 2;
+    default:
+        return 3;
+    }
+}
+
+/**
+ * @brief Write value with decimals digits after the point into buf (at least 32 bytes).
+ *
+ * Rounds half away from zero, as the stamps do. NaN and infinities are
+ * written as "nan" and "inf", very large values fall back to printf.
+ * @return number of characters written
+ */
+int LineFormatter::formatFixed(char *buf, double value, int decimals)
+{
+    static const double scale[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6 };
+    decimals = qBound(0, decimals, 6);
+
+    if (std::isnan(value)) { buf[0] = 'n'; buf[1] = 'a'; buf[2] = 'n'; return 3; }
+    if (std::isinf(value)) {
+        int n = 0;
+        if (value < 0) buf[n++] = '-';
+        buf[n++] = 'i'; buf[n++] = 'n'; buf[n++] = 'f';
+        return n;
+    }
+    double scaled = std::fabs(value)*scale[decimals] + 0.5;
+    if (scaled >= 9e15) return std::snprintf(buf, 32, "%.*f", decimals, value);
+
+    quint64 units = quint64(scaled);
+    char digits[24];
+    int n = 0;
+    do {
+        digits[n++] = char('0' + units%10);
+        units /= 10;
+    } while (units > 0 || n <= decimals);   // at least one digit before the point
+
+    char *p = buf;
+    if (value < 0 && quint64(scaled) > 0) *p++ = '-';
+    while (n > decimals) *p++ = digits[--n];
+    if (decimals > 0) {
+        *p++ = '.';
+        while (n > 0) *p++ = digits[--n];
+    }
+    return int(p - buf);
+}
+
+/**
+ * @brief Write value in decimal into buf (at least 21 bytes).
+ * @return number of characters written
+ */
+int LineFormatter::formatInt(char *buf, qint64 value)
+{
+    char digits[20];
+    quint64 u = value < 0 ? 0 - quint64(value) : quint64(value);
+    int n = 0;
+    do {
+        digits[n++] = char('0' + u%10);
+        u /= 10;
+    } while (u > 0);
+
+    char *p = buf;
+    if (value < 0) *p++ = '-';
+    while (n > 0) *p++ = digits[--n];
+    return int(p - buf);
+}
+
+/**
+ * @brief Cache the local date and midnight of timeMs.
+ *
+ * The cache stays valid until the next midnight, or until the next
+ * daylight saving transition if that comes first.
+ */
+void LineFormatter::updateDay(qint64 timeMs)
+{
+    QDateTime dt = QDateTime::fromMSecsSinceEpoch(timeMs);
+    dayStartMs = timeMs - dt.time().msecsSinceStartOfDay();
+    validFromMs = dayStartMs;
+    validToMs = dayStartMs + 24*3600*1000;
+
+    QTimeZone tz = QTimeZone::systemTimeZone();
+    if (tz.hasTransitions()) {
+        QTimeZone::OffsetData prev = tz.previousTransition(dt.addMSecs(1));
+        if (prev.atUtc.isValid()) validFromMs = qMax(validFromMs, prev.atUtc.toMSecsSinceEpoch());
+        QTimeZone::OffsetData next = tz.nextTransition(dt);
+        if (next.atUtc.isValid()) validToMs = qMin(validToMs, next.atUtc.toMSecsSinceEpoch());
+    }
+
+    QByteArray d = dt.date().toString("yyyy-MM-dd").toLatin1();
+    for (int i = 0; i < 10; ++i) date[i] = i < d.size() ? d.at(i) : ' ';
+}
@@ -0,0 +1,65 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef LINEFORMATTER_H
+#define LINEFORMATTER_H
+
+#include <QByteArray>
+
+#include "atlasreading.h"
+
+/** @brief Renders the text log columns straight into a UTF-8 byte buffer.
+ *
+ * The "yyyy-MM-dd" date is formatted once per local day and reused until
+ * midnight (or the next UTC offset change); time of day and values are
+ * written digit by digit into a reusable buffer, without QString or QDateTime.
+*/
+class LineFormatter
+{
+public:
+    LineFormatter();
+
+    void appendTimestamp(QByteArray &out, qint64 timeMs, bool millis = false);
+    void appendValue(QByteArray &out, double value, int channel);
+    void appendInt(QByteArray &out, qint64 value);
+
+    static int decimalsFor(int channel);
+    static int formatFixed(char *buf, double value, int decimals);
+    static int formatInt(char *buf, qint64 value);
+
+private:
+    void updateDay(qint64 timeMs);
+
+    char buf[64];              /**< scratch for one timestamp or number */
+    char date[10];             /**< "yyyy-MM-dd" of the cached day */
+    qint64 dayStartMs = 0;     /**< local midnight of the cached day, in ms since epoch */
+    qint64 validFromMs = 0;    /**< the cached day and UTC offset apply from here ... */
+    qint64 validToMs = 0;      /**< ... up to (excluding) here */
+};
+
+#endif // LINEFORMATTER_H
@@ -1,6 +1,12 @@
 #include "loggingframe.h"
 #include "ui_loggingframe.h"
 #include <QDebug>
+#include <QDateTime>
+#include <QStringList>
+#include <QFileInfo>
+
+#include "logstore.h"
+#include "logrollup.h"
 
 LoggingFrame::LoggingFrame(QWidget *parent) :
     QFrame(parent),
@@ -8,45 +14,107 @@ LoggingFrame::LoggingFrame(QWidget *parent) :
 {
     ui->setupUi(this);
     logDir = QDir("C:/Data");
+    ui->dteTo->setDateTime(QDateTime::currentDateTime());
+    ui->dteFrom->setDateTime(QDateTime::currentDateTime().addSecs(-3600));
+    writer = new LogWriter(this);
+
+    droppedTimer = new QTimer(this);
+    connect( droppedTimer, SIGNAL(timeout()),
+             this, SLOT(displayDropped()) );
 }
 
 LoggingFrame::~LoggingFrame()
 {
+    writer->close();
     delete ui;
 }
 
 // http://www.bogotobogo.com/Qt/Qt5_QFile.php
 
+/**
+ * @brief Write a text line (comment) to the log file.
+ *
+ * Lines are queued for the log writer thread, file I/O never runs on the GUI thread.
+ */
 void LoggingFrame::write(const QString &line)
 {
-    //QFile file("C:/Test/simple.txt");
-    if(logFile.isOpen() ) {
-        logStream << line << endl;
-        //qDebug() << "Writing finished";
-    } else {
-        //qDebug() << "Error: logging stream not open";
-    }
+    writer->writeComment(line);
 }
 
-void LoggingFrame::read()
+/**
+ * @brief Write one reading to the log file as "unixTime, yyyy-MM-dd, hh:mm:ss, value".
+ */
+void LoggingFrame::writeReading(const AtlasReading &reading)
 {
-    //QFile file("C:/Test/simple.txt");
-    if(logFile.open(QIODevice::ReadOnly | QIODevice::Text))
-    {
-        // We're going to streaming the file
-        // to the QString
-        QTextStream stream(&logFile);
+    writer->writeReading(reading);
+}
 
-        QString line;
-        do {
-            line = stream.readLine();
-            qDebug() << line;
-        } while(!line.isNull());
+/**
+ * @brief Write one aligned row of a synchronized acquisition group.
+ *
+ * One line per tick: the common acquisition time, followed by
+ * value and arrival delta (ms) of every stamp.
+ * A stamp that did not answer within the window leaves both fields empty.
+ */
+void LoggingFrame::writeRow(const AtlasReadingRow &row)
+{
+    writer->writeRow(row);
+}
 
-        logFile.close();
-        //qDebug() << "Reading finished";
+/**
+ * @brief Show the readings of the log file between fromMs and toMs.
+ *
+ * Uses the time index of the log, only the requested window is read from disk.
+ * Windows with more than maxLines seconds are shown from the finest rollup tier
+ * that gives at most about maxLines lines per stamp.
+ */
+void LoggingFrame::read(qint64 fromMs, qint64 toMs)
+{
+    const int maxLines = 10000;
+    QFileInfo fi(logFile.fileName());
+    QVector<RollupBucket> buckets;
+    qint64 resolutionMs = (toMs - fromMs)/maxLines;
+    if (resolutionMs >= LogRollup::tierWidthMs(0)) {
+        int tier = LogRollup::tierCovering(resolutionMs);
+        buckets = LogRollup::query(fi.dir().absoluteFilePath(fi.completeBaseName()),
+                                   fromMs, toMs, LogRollup::tierWidthMs(tier), maxLines);
+    }
+    if (!buckets.isEmpty()) {
+        QStringList lines;
+        lines.reserve(buckets.size());
+        for (int i = 0; i < buckets.size(); ++i) {
+            const RollupBucket &b = buckets.at(i);
+            lines.append(QString("%1  %2  %3  [%4 .. %5]  n=%6")
+                         .arg(QDateTime::fromMSecsSinceEpoch(b.startMs).toString("yyyy-MM-dd hh:mm:ss"))
+                         .arg(b.stampId)
+                         .arg(b.mean)
+                         .arg(b.min)
+                         .arg(b.max)
+                         .arg(b.count));
+        }
+        if (buckets.size() == maxLines) lines.append(tr("... first %1 summaries shown").arg(maxLines));
+        ui->plainTextEdit->setPlainText(lines.join('\n'));
+        return;
+    }
+
+    LogStore store(logFile.fileName());
+    if (!store.isValid()) {
+        ui->plainTextEdit->setPlainText(tr("No log file %1").arg(logFile.fileName()));
+        return;
     }
 
+    QVector<AtlasReading> readings = store.query(fromMs, toMs, maxLines);
+    QStringList lines;
+    lines.reserve(readings.size());
+    for (int i = 0; i < readings.size(); ++i) {
+        const AtlasReading &r = readings.at(i);
+        lines.append(QString("%1  %2  %3")
+                     .arg(QDateTime::fromMSecsSinceEpoch(r.timeMs).toString("yyyy-MM-dd hh:mm:ss.zzz"))
+                     .arg(r.stampId)
+                     .arg(r.value));
+    }
+    if (readings.size() == maxLines) lines.append(tr("... first %1 readings shown").arg(maxLines));
+    ui->plainTextEdit->setPlainText(lines.join('\n'));
 }
 
 QDir LoggingFrame::getLogDir() const
@@ -67,7 +135,7 @@ void LoggingFrame::on_btnWrite_clicked()
 
 void LoggingFrame::on_btnRead_clicked()
 {
-    //read();
+    read(ui->dteFrom->dateTime().toMSecsSinceEpoch(), ui->dteTo->dateTime().toMSecsSinceEpoch());
 }
 
 void LoggingFrame::setLogFile(const QString &value)
@@ -76,6 +144,71 @@ void LoggingFrame::setLogFile(const QString &value)
     ui->leLogDir->setText(logFile.fileName());
 }
 
+/**
+ * @brief Set the header line written at the start of the next log file.
+ */
+void LoggingFrame::setHeader(const QString &value)
+{
+    header = value;
+}
+
+/**
+ * @brief Set the stamp columns of the next binary log file.
+ */
+void LoggingFrame::setColumns(const QVector<BinLogColumn> &value)
+{
+    writer->setColumns(value);
+}
+
+/**
+ * @brief Set size/time based rotation of the next log file.
+ *
+ * Rotated logs are written as Atlas_<timestamp>_NNNN.log segments
+ * listed in Atlas_<timestamp>.manifest.
+ */
+void LoggingFrame::setRotation(const LogWriter::RotationPolicy &value)
+{
+    writer->setRotation(value);
+}
+
+/**
+ * @brief Keep a checksummed journal <log>.wal next to the next log file.
+ */
+void LoggingFrame::setJournal(bool value)
+{
+    writer->setJournal(value);
+}
+
+/**
+ * @brief Check the journals in the log directory after a crash.
+ *
+ * A torn block at the end of a journal is cut off, so the journal holds only
+ * complete, checksummed readings and can be appended to again.
+ * @return number of journals that had a torn tail
+ */
+int LoggingFrame::recoverJournals()
+{
+    int repaired = 0;
+    QStringList journals = logDir.entryList(QStringList() << "*.wal", QDir::Files);
+    for (int i = 0; i < journals.size(); ++i) {
+        ReadingJournal::Recovery rec = ReadingJournal::recover(logDir.absoluteFilePath(journals.at(i)));
+        if (rec.truncatedBytes > 0) {
+            ui->plainTextEdit->appendPlainText(tr("%1: %2 readings recovered, torn tail of %3 bytes removed")
+                                               .arg(journals.at(i)).arg(rec.records).arg(rec.truncatedBytes));
+            ++repaired;
+        }
+    }
+    return repaired;
+}
+
+/**
+ * @brief True if the next log file is written in the binary block format.
+ */
+bool LoggingFrame::isBinary() const
+{
+    return ui->cbBinary->isChecked();
+}
+
 /**
  * @brief LoggingFrame::on_btnStart_clicked
  *
@@ -83,20 +216,32 @@ void LoggingFrame::setLogFile(const QString &value)
  */
 void LoggingFrame::on_btnStart_clicked()
 {
-    if(logFile.open(QIODevice::ReadWrite | QIODevice::Text)) {
-        // We're going to streaming text to the file
+    writer->setFormat(isBinary() ? LogWriter::lfBinary : LogWriter::lfCsv);
+    logDir.mkpath(".");
+    // the writer thread writes the header line and all queued records, in UTF-8
+    if (writer->open(logFile.fileName(), header)) {
         qDebug() << logFile.fileName();
-        logStream.setDevice(&logFile);
-        logStream.setCodec("UTF-8");
-
-        // Write header line to log file:
-        logStream << "# unixTime, yyyy-MM-dd, hh:mm:ss, pH" << endl;
+        displayDropped();
+        droppedTimer->start(1000);
     }
 }
 
 void LoggingFrame::on_btnStop_clicked()
 {
-    if(logFile.isOpen()) {
-        logFile.close();
+    writer->close();
+    droppedTimer->stop();
+    displayDropped();
+    if (writer->getDropped() > 0) {
+        qDebug() << "Log queue full," << writer->getDropped() << "records dropped";
     }
 }
+
+/**
+ * @brief Show the number of records dropped because the log queue was full, red if any.
+ */
+void LoggingFrame::displayDropped()
+{
+    quint64 dropped = writer->getDropped();
+    ui->lblDropped->setText(tr("Dropped: %1").arg(dropped));
+    ui->lblDropped->setStyleSheet(dropped > 0 ? "QLabel {color : red;}" : "");
+}
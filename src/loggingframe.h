@@ -6,6 +6,10 @@
 #include <QDir>
 #include <QTextStream>
 #include <QFile>
+#include <QTimer>
+
+#include "atlasreading.h"
+#include "logwriter.h"
 
 namespace Ui {
 class LoggingFrame;
@@ -23,9 +27,17 @@ public:
     QDir getLogDir() const;
     void setLogDir(const QDir &value);
     void setLogFile(const QString &value);
+    void setHeader(const QString &value);
+    void setColumns(const QVector<BinLogColumn> &value);
+    void setRotation(const LogWriter::RotationPolicy &value);
+    void setJournal(bool value);
+    bool isBinary() const;
 
     void write(const QString &line);
-    void read();
+    void writeReading(const AtlasReading &reading);
+    void writeRow(const AtlasReadingRow &row);
+    void read(qint64 fromMs, qint64 toMs);
+    int recoverJournals();
 
     void on_btnStart_clicked();
     void on_btnStop_clicked();
@@ -33,6 +45,7 @@ public:
 private slots:
     void on_btnWrite_clicked();
     void on_btnRead_clicked();
+    void displayDropped();
 
 
 
@@ -40,7 +53,9 @@ private:
     Ui::LoggingFrame *ui;
     QDir logDir;
     QFile logFile;
-    QTextStream logStream;
+    LogWriter* writer;
+    QTimer* droppedTimer;       /**< updates the dropped record count while logging */
+    QString header = "# unixTime, yyyy-MM-dd, hh:mm:ss, pH";
 };
 
 #endif // LOGGINGFRAME_H
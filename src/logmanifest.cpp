@@ -0,0 +1,275 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "logmanifest.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QDataStream>
+#include <QMutexLocker>
+#include <QtDebug>
+#include <algorithm>
+
+LogManifest::LogManifest(const QString &fileName) :
+    fileName(fileName)
+{
+
+}
+
+/**
+ * @brief Read the manifest file.
+ *
+ * Line format: file, firstTimeMs, lastTimeMs, records, bytes, compressed, open
+ */
+bool LogManifest::load()
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) return false;
+
+    QMutexLocker locker(&mutex);
+    list.clear();
+    QTextStream in(&f);
+    while (!in.atEnd()) {
+        QString line = in.readLine();
+        if (line.startsWith('#') || line.trimmed().isEmpty()) continue;
+        QStringList fields = line.split(',');
+        if (fields.size() < 7) continue;
+        LogSegment s;
+        s.fileName = fields.at(0).trimmed();
+        s.firstTimeMs = fields.at(1).trimmed().toLongLong();
+        s.lastTimeMs = fields.at(2).trimmed().toLongLong();
+        s.records = fields.at(3).trimmed().toLongLong();
+        s.bytes = fields.at(4).trimmed().toLongLong();
+        s.compressed = (fields.at(5).trimmed().toInt() != 0);
+        s.open = (fields.at(6).trimmed().toInt() != 0);
+        list.append(s);
+    }
+    return true;
+}
+
+bool LogManifest::save()
+{
+    QMutexLocker locker(&mutex);
+    return saveLocked();
+}
+
+/**
+ * @brief Rewrite the manifest; QSaveFile replaces it atomically, a reader never sees half a file.
+ */
+bool LogManifest::saveLocked()
+{
+    if (fileName.isEmpty()) return false;
+
+    QSaveFile f(fileName);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Text)) return false;
+
+    QTextStream out(&f);
+    out << "# file, firstTimeMs, lastTimeMs, records, bytes, compressed, open\n";
+    for (int i = 0; i < list.size(); ++i) {
+        const LogSegment &s = list.at(i);
+        out << s.fileName << ", " << s.firstTimeMs << ", " << s.lastTimeMs << ", "
+            << s.records << ", " << s.bytes << ", " << (s.compressed ? 1 : 0) << ", "
+            << (s.open ? 1 : 0) << "\n";
+    }
+    out.flush();
+    return f.commit();
+}
+
+/**
+ * @brief Add a closed segment and save the manifest; it replaces the open segment entry.
+ *
+ * @return index of the segment, used by setCompressed()
+ */
+int LogManifest::append(const LogSegment &segment)
+{
+    QMutexLocker locker(&mutex);
+    LogSegment s = segment;
+    s.fileName = QFileInfo(segment.fileName).fileName();
+    s.open = false;
+    if (!list.isEmpty() && list.last().open) list.removeLast();
+    list.append(s);
+    saveLocked();
+    return list.size() - 1;
+}
+
+/**
+ * @brief Record the segment the writer has just opened and save the manifest.
+ *
+ * Readers see the live segment, also before the first rotation.
+ */
+void LogManifest::setOpen(const QString &fileName)
+{
+    QMutexLocker locker(&mutex);
+    if (!list.isEmpty() && list.last().open) list.removeLast();
+    LogSegment s;
+    s.fileName = QFileInfo(fileName).fileName();
+    s.open = true;
+    list.append(s);
+    saveLocked();
+}
+
+/**
+ * @brief Remove the open segment entry, e.g. when the writer closes an empty segment.
+ */
+void LogManifest::clearOpen()
+{
+    QMutexLocker locker(&mutex);
+    if (list.isEmpty() || !list.last().open) return;
+    list.removeLast();
+    saveLocked();
+}
+
+void LogManifest::setCompressed(int index, const QString &fileName, qint64 bytes)
+{
+    QMutexLocker locker(&mutex);
+    if (index < 0 || index >= list.size()) return;
+    list[index].fileName = QFileInfo(fileName).fileName();
+    list[index].bytes = bytes;
+    list[index].compressed = true;
+    saveLocked();
+}
+
+QVector<LogSegment> LogManifest::segments() const
+{
+    QMutexLocker locker(&mutex);
+    return list;
+}
+
+/**
+ * @brief Segments with records between fromMs and toMs.
+ *
+ * Closed segments are in time order, the first candidate is found by binary search.
+ * The open segment has no time range yet and is always included: it holds the newest records.
+ */
+QVector<LogSegment> LogManifest::segmentsInRange(qint64 fromMs, qint64 toMs) const
+{
+    QMutexLocker locker(&mutex);
+    QVector<LogSegment> result;
+    QVector<LogSegment>::const_iterator end = list.constEnd();
+    if (!list.isEmpty() && list.last().open) --end;
+    QVector<LogSegment>::const_iterator it = std::lower_bound(list.constBegin(), end, fromMs,
+        [](const LogSegment &s, qint64 t) { return s.lastTimeMs < t; });
+    for (; it != end && it->firstTimeMs <= toMs; ++it) result.append(*it);
+    if (end != list.constEnd()) result.append(list.last());
+    return result;
+}
+
+/**
+ * @brief Full path of a segment: segments are stored next to the manifest.
+ */
+QString LogManifest::filePath(const LogSegment &segment) const
+{
+    return QFileInfo(fileName).dir().absoluteFilePath(segment.fileName);
+}
+
+QString LogManifest::getFileName() const
+{
+    return fileName;
+}
+
+//----------------------------------------------------------------
+SegmentCompressor::SegmentCompressor(QSharedPointer<LogManifest> manifest, int index, const QString &fileName) :
+    manifest(manifest),
+    index(index),
+    fileName(fileName)
+{
+    setAutoDelete(true);
+}
+
+static const char qzMagic[] = "ATQZ";
+
+/**
+ * @brief Compress the segment into "<segment>.qz" and remove the original.
+ *
+ * File format: "ATQZ", then per block its compressed size (quint32, big endian)
+ * and the block in qCompress format.
+ * The manifest names the ".qz" before the original is removed,
+ * so a reader or a crash never finds the manifest pointing to a missing file.
+ */
+void SegmentCompressor::run()
+{
+    QFile in(fileName);
+    if (!in.open(QIODevice::ReadOnly)) return;
+
+    QString qzName = fileName + ".qz";
+    QSaveFile out(qzName);
+    if (!out.open(QIODevice::WriteOnly)) {
+        qDebug() << "SegmentCompressor: cannot write" << qzName;
+        return;
+    }
+    QDataStream stream(&out);
+    stream.writeRawData(qzMagic, 4);
+    while (!in.atEnd()) {
+        QByteArray packed = qCompress(in.read(blockSize), 6);
+        stream << quint32(packed.size());
+        stream.writeRawData(packed.constData(), packed.size());
+    }
+    bool readOk = (in.error() == QFile::NoError);
+    in.close();
+    qint64 bytes = out.size();
+    if (!readOk || stream.status() != QDataStream::Ok || !out.commit()) {
+        qDebug() << "SegmentCompressor: cannot write" << qzName;
+        return;
+    }
+    manifest->setCompressed(index, qzName, bytes);
+    QFile::remove(fileName);
+}
+
+/**
+ * @brief Read and uncompress a ".qz" segment.
+ *
+ * @return empty if the file is not a ".qz" segment or a block is truncated or corrupt,
+ * a shortened segment is never returned
+ */
+QByteArray SegmentCompressor::uncompressFile(const QString &fileName)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly)) return QByteArray();
+    if (f.read(4) != QByteArray(qzMagic, 4)) {
+        qDebug() << "SegmentCompressor: not a compressed segment" << fileName;
+        return QByteArray();
+    }
+
+    QDataStream stream(&f);
+    QByteArray data;
+    while (!f.atEnd()) {
+        quint32 n;
+        stream >> n;
+        QByteArray packed = f.read(n);
+        QByteArray block;
+        if (stream.status() == QDataStream::Ok && packed.size() == int(n) && n > 0) block = qUncompress(packed);
+        if (block.isEmpty()) {
+            qDebug() << "SegmentCompressor: truncated or corrupt block in" << fileName;
+            return QByteArray();
+        }
+        data.append(block);
+    }
+    return data;
+}
@@ -0,0 +1,102 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef LOGMANIFEST_H
+#define LOGMANIFEST_H
+
+#include <QString>
+#include <QVector>
+#include <QMutex>
+#include <QRunnable>
+#include <QSharedPointer>
+
+/** @brief One segment of a rotated log; the last one may still be open. */
+struct LogSegment {
+    QString fileName;       /**< file name relative to the manifest, ".qz" when compressed */
+    qint64  firstTimeMs = 0; /**< time of the first record, ms since epoch */
+    qint64  lastTimeMs = 0;  /**< time of the last record */
+    qint64  records = 0;
+    qint64  bytes = 0;       /**< size on disk */
+    bool    compressed = false;
+    bool    open = false;     /**< still being written, time range and size not known yet */
+    };
+
+/** @brief List of the segments of a rotated log, kept in a text file next to the segments.
+ *
+ * Thread safe: segments are added by the log writer thread
+ * and updated by the background compression.
+*/
+class LogManifest
+{
+public:
+    explicit LogManifest(const QString &fileName = QString());
+
+    bool load();
+    bool save();
+
+    int append(const LogSegment &segment);
+    void setOpen(const QString &fileName);
+    void clearOpen();
+    void setCompressed(int index, const QString &fileName, qint64 bytes);
+
+    QVector<LogSegment> segments() const;
+    QVector<LogSegment> segmentsInRange(qint64 fromMs, qint64 toMs) const;
+    QString filePath(const LogSegment &segment) const;
+    QString getFileName() const;
+
+private:
+    bool saveLocked();
+
+    mutable QMutex mutex;
+    QString fileName;
+    QVector<LogSegment> list;
+};
+
+/** @brief Compresses one closed log segment on a QThreadPool thread.
+ *
+ * The segment is replaced by "<segment>.qz" and the manifest is updated.
+ * The segment is compressed in blocks of blockSize bytes, each in qCompress format
+ * preceded by its compressed size, so memory use does not depend on the segment size.
+*/
+class SegmentCompressor : public QRunnable
+{
+public:
+    SegmentCompressor(QSharedPointer<LogManifest> manifest, int index, const QString &fileName);
+    void run();
+
+    static QByteArray uncompressFile(const QString &fileName);
+
+    static const int blockSize = 1024*1024;
+
+private:
+    QSharedPointer<LogManifest> manifest;
+    int index;
+    QString fileName;
+};
+
+#endif // LOGMANIFEST_H
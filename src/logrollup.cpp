@@ -0,0 +1,219 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "logrollup.h"
+#include <QtDebug>
+#include <algorithm>
+#include <cstring>
+
+static_assert(sizeof(RollupBucket) == 48, "rollup bucket must be 48 bytes");
+
+static const qint64 kTierWidthMs[LogRollup::kTierCount] = { 1000, 60*1000, 3600*1000 };
+static const char * const kTierSuffix[LogRollup::kTierCount] = { ".r1s", ".r1m", ".r1h" };
+
+LogRollup::LogRollup()
+{
+
+}
+
+LogRollup::~LogRollup()
+{
+    close();
+}
+
+/**
+ * @brief Open (append to) the tier files of a log.
+ *
+ * @param basePath path of the log without suffix and segment number
+ */
+bool LogRollup::open(const QString &basePath)
+{
+    close();
+    for (int t = 0; t < kTierCount; ++t) {
+        Tier &tier = tiers[t];
+        tier.file.setFileName(tierFileName(basePath, t));
+        if (!tier.file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qDebug() << "LogRollup: cannot open" << tier.file.fileName();
+            close();
+            return false;
+        }
+        tier.batch.clear();
+        tier.startMs = -1;
+        tier.open.clear();
+    }
+    return true;
+}
+
+bool LogRollup::isOpen() const
+{
+    return tiers[0].file.isOpen();
+}
+
+/**
+ * @brief Add one reading to the open bucket of its stamp in every tier.
+ *
+ * A reading in a later bucket closes all open buckets of the tier.
+ * A reading older than the open buckets (clock set back) is counted in the open buckets.
+ */
+void LogRollup::add(const AtlasReading &reading)
+{
+    if (!isOpen()) return;
+
+    for (int t = 0; t < kTierCount; ++t) {
+        Tier &tier = tiers[t];
+        qint64 start = reading.timeMs - reading.timeMs % kTierWidthMs[t];
+        if (tier.startMs >= 0 && start > tier.startMs) closeBuckets(t);
+        if (tier.startMs < 0) tier.startMs = start;
+
+        if (tier.open.size() <= reading.stampId) tier.open.resize(reading.stampId + 1);
+        RollupBucket &b = tier.open[reading.stampId];
+        if (b.count == 0) {
+            b.startMs = tier.startMs;
+            b.stampId = reading.stampId;
+            b.channel = reading.channel;
+            b.min = reading.value;
+            b.max = reading.value;
+            b.mean = 0.0;
+        }
+        ++b.count;
+        b.min = qMin(b.min, reading.value);
+        b.max = qMax(b.max, reading.value);
+        b.mean += (reading.value - b.mean)/b.count;     // running mean, no large sums
+        b.last = reading.value;
+    }
+}
+
+/**
+ * @brief Move the open buckets of a tier, in stampId order, to its batch.
+ */
+void LogRollup::closeBuckets(int tier)
+{
+    Tier &tr = tiers[tier];
+    for (int i = 0; i < tr.open.size(); ++i) {
+        RollupBucket &b = tr.open[i];
+        if (b.count == 0) continue;
+        tr.batch.append(reinterpret_cast<const char*>(&b), sizeof(RollupBucket));
+        b.count = 0;
+    }
+    tr.startMs = -1;
+}
+
+/**
+ * @brief Write the closed buckets; called with the group commit of the log writer.
+ */
+void LogRollup::commit()
+{
+    for (int t = 0; t < kTierCount; ++t) {
+        Tier &tier = tiers[t];
+        if (tier.batch.isEmpty() || !tier.file.isOpen()) continue;
+        tier.file.write(tier.batch);
+        tier.file.flush();
+        tier.batch.clear();
+    }
+}
+
+/**
+ * @brief Close the open buckets, write them and close the tier files.
+ */
+void LogRollup::close()
+{
+    if (!isOpen()) return;
+    for (int t = 0; t < kTierCount; ++t) closeBuckets(t);
+    commit();
+    for (int t = 0; t < kTierCount; ++t) tiers[t].file.close();
+}
+
+qint64 LogRollup::tierWidthMs(int tier)
+{
+    return kTierWidthMs[tier];
+}
+
+/**
+ * @brief Coarsest tier whose bucket width is not larger than resolutionMs, -1: use raw data.
+ */
+int LogRollup::tierFor(qint64 resolutionMs)
+{
+    int tier = -1;
+    for (int t = 0; t < kTierCount; ++t) {
+        if (kTierWidthMs[t] <= resolutionMs) tier = t;
+    }
+    return tier;
+}
+
+/**
+ * @brief Finest tier whose bucket width is at least resolutionMs; the coarsest tier if none is.
+ *
+ * A window of span ms read from this tier gives at most about span/resolutionMs buckets per stamp.
+ */
+int LogRollup::tierCovering(qint64 resolutionMs)
+{
+    for (int t = 0; t < kTierCount; ++t) {
+        if (kTierWidthMs[t] >= resolutionMs) return t;
+    }
+    return kTierCount - 1;
+}
+
+QString LogRollup::tierFileName(const QString &basePath, int tier)
+{
+    return basePath + kTierSuffix[tier];
+}
+
+/**
+ * @brief Buckets between fromMs and toMs from the coarsest tier that gives resolutionMs.
+ *
+ * The tier file is sorted by time, the first bucket is found by binary search.
+ * @param maxBuckets stop after this many buckets, -1: all
+ * @return empty if resolutionMs is finer than the finest tier or there is no tier file
+ */
+QVector<RollupBucket> LogRollup::query(const QString &basePath, qint64 fromMs, qint64 toMs,
+                                       qint64 resolutionMs, int maxBuckets)
+{
+    QVector<RollupBucket> result;
+    int tier = tierFor(resolutionMs);
+    if (tier < 0) return result;
+
+    QFile f(tierFileName(basePath, tier));
+    if (!f.open(QIODevice::ReadOnly)) return result;
+    qint64 n = f.size() / qint64(sizeof(RollupBucket));
+    if (n == 0) return result;
+    const uchar *map = f.map(0, n*sizeof(RollupBucket));
+    if (!map) return result;
+
+    const RollupBucket *first = reinterpret_cast<const RollupBucket*>(map);
+    const RollupBucket *last = first + n;
+    // the bucket containing fromMs starts at most one width earlier
+    const RollupBucket *it = std::lower_bound(first, last, fromMs - kTierWidthMs[tier] + 1,
+        [](const RollupBucket &b, qint64 t) { return b.startMs < t; });
+    for (; it != last && it->startMs <= toMs; ++it) {
+        if (maxBuckets >= 0 && result.size() >= maxBuckets) break;
+        result.append(*it);
+    }
+
+    f.unmap(const_cast<uchar*>(map));
+    return result;
+}
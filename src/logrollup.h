@@ -0,0 +1,89 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef LOGROLLUP_H
+#define LOGROLLUP_H
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+
+#include "atlasreading.h"
+
+/** @brief Summary of the readings of one stamp in one time bucket; stored as-is in the tier files. */
+struct RollupBucket {
+    qint64  startMs = 0;    /**< start of the bucket, ms since epoch, multiple of the tier width */
+    quint16 stampId = 0;
+    quint16 channel = 0;    /**< probe type, see AtlasReading::Channel */
+    quint32 count = 0;      /**< number of readings */
+    double  min = 0.0;
+    double  max = 0.0;
+    double  mean = 0.0;
+    double  last = 0.0;     /**< last reading in the bucket */
+    };
+
+/** @brief Downsampled tiers (1 s, 1 min, 1 h) of a log, updated with every reading.
+ *
+ * Tier files "<log>.r1s", "<log>.r1m", "<log>.r1h" hold closed buckets in time order.
+ * All buckets of a tier close together, when the first reading of the next bucket arrives.
+*/
+class LogRollup
+{
+public:
+    enum { kTierCount = 3 };
+
+    LogRollup();
+    ~LogRollup();
+
+    bool open(const QString &basePath);
+    void add(const AtlasReading &reading);
+    void commit();
+    void close();
+    bool isOpen() const;
+
+    static qint64 tierWidthMs(int tier);
+    static int tierFor(qint64 resolutionMs);
+    static int tierCovering(qint64 resolutionMs);
+    static QString tierFileName(const QString &basePath, int tier);
+    static QVector<RollupBucket> query(const QString &basePath, qint64 fromMs, qint64 toMs,
+                                       qint64 resolutionMs, int maxBuckets = -1);
+
+private:
+    void closeBuckets(int tier);
+
+    struct Tier {
+        QFile file;
+        QByteArray batch;               /**< closed buckets not yet written */
+        qint64 startMs = -1;            /**< start of the open buckets, -1: none open */
+        QVector<RollupBucket> open;     /**< open bucket per stampId, count 0: unused */
+    };
+    Tier tiers[kTierCount];
+};
+
+#endif // LOGROLLUP_H
@@ -0,0 +1,390 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "logstore.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QBuffer>
+#include <QList>
+#include <QtNumeric>
+#include <cstring>
+#include <algorithm>
+
+/**
+ * @brief Open a log for queries.
+ *
+ * @param fileName CSV log, binary log or manifest of a rotated log;
+ * for a rotated log the name given to the writer (without segment number) also works
+ */
+LogStore::LogStore(const QString &fileName) :
+    fileName(fileName)
+{
+    QFileInfo fi(fileName);
+    QString manifestName;
+    if (fi.suffix() == "manifest") {
+        manifestName = fileName;
+    } else if (!fi.exists()) {
+        manifestName = fi.dir().absoluteFilePath(fi.completeBaseName() + ".manifest");
+    }
+    if (!manifestName.isEmpty()) {
+        manifest = QSharedPointer<LogManifest>(new LogManifest(manifestName));
+        if (!manifest->load()) manifest.clear();
+    }
+}
+
+bool LogStore::isValid() const
+{
+    return manifest || QFile::exists(fileName);
+}
+
+bool LogStore::isRotated() const
+{
+    return !manifest.isNull();
+}
+
+QString LogStore::getFileName() const
+{
+    return fileName;
+}
+
+/**
+ * @brief Readings with fromMs <= time <= toMs, at most maxRecords (-1: all).
+ */
+QVector<AtlasReading> LogStore::query(qint64 fromMs, qint64 toMs, int maxRecords) const
+{
+    QVector<AtlasReading> result;
+    scan(fromMs, toMs, [&result, maxRecords](const AtlasReading &r) {
+        result.append(r);
+        return maxRecords < 0 || result.size() < maxRecords;
+    });
+    return result;
+}
+
+/**
+ * @brief Call visit for each reading with fromMs <= time <= toMs, in file order.
+ *
+ * Memory use does not depend on the size of the log, except for
+ * compressed segments that are uncompressed one at a time.
+ * @return false if visit stopped the scan
+ */
+bool LogStore::scan(qint64 fromMs, qint64 toMs, const Visitor &visit) const
+{
+    LogCursor cursor(*this, fromMs, toMs);
+    AtlasReading r;
+    while (cursor.next(r)) {
+        if (!visit(r)) return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Files that may hold readings between fromMs and toMs, in time order.
+ *
+ * The log file itself, or the segments of a rotated log selected by the manifest.
+ */
+QStringList LogStore::files(qint64 fromMs, qint64 toMs) const
+{
+    QStringList paths;
+    if (!manifest) {
+        paths.append(fileName);
+        return paths;
+    }
+    QVector<LogSegment> segments = manifest->segmentsInRange(fromMs, toMs);
+    for (int i = 0; i < segments.size(); ++i) paths.append(manifest->filePath(segments.at(i)));
+    return paths;
+}
+
+/**
+ * @brief Read a sparse index file; empty if there is none.
+ */
+QVector<LogIndexEntry> LogStore::loadIndex(const QString &indexFileName)
+{
+    QVector<LogIndexEntry> index;
+    QFile f(indexFileName);
+    if (!f.open(QIODevice::ReadOnly)) return index;
+
+    QByteArray data = f.readAll();
+    index.resize(data.size() / int(sizeof(LogIndexEntry)));
+    std::memcpy(index.data(), data.constData(), index.size()*sizeof(LogIndexEntry));
+    return index;
+}
+
+/**
+ * @brief File offset to start reading for fromMs: the last index entry before fromMs.
+ *
+ * Every line before that entry is older than fromMs; O(log n).
+ */
+qint64 LogStore::seekOffset(const QVector<LogIndexEntry> &index, qint64 fromMs)
+{
+    QVector<LogIndexEntry>::const_iterator it = std::lower_bound(index.constBegin(), index.constEnd(), fromMs,
+        [](const LogIndexEntry &e, qint64 t) { return e.timeMs < t; });
+    if (it == index.constBegin()) return 0;
+    return (it - 1)->offset;
+}
+
+/**
+ * @brief Parse one CSV log line into readings.
+ *
+ * "unixTime, yyyy-MM-dd, hh:mm:ss, value" gives one reading of channel,
+ * "unixTime, yyyy-MM-dd, hh:mm:ss.zzz, value0, dt0_ms, value1, dt1_ms, ..." one per stamp that answered.
+ * @return false for comment, header and malformed lines
+ */
+bool LogStore::parseCsvLine(const QByteArray &line, int channel, AtlasReadingRow &row)
+{
+    row.clear();
+    if (line.isEmpty() || line.at(0) == '#') return false;
+
+    QList<QByteArray> fields = line.split(',');
+    if (fields.size() < 4) return false;
+
+    bool ok;
+    qint64 t = fields.at(0).trimmed().toLongLong(&ok)*1000;
+    if (!ok) return false;
+    QByteArray tod = fields.at(2).trimmed();
+    int dot = tod.indexOf('.');
+    if (dot >= 0) t += tod.mid(dot + 1).toInt();
+
+    if (fields.size() == 4) {
+        AtlasReading r;
+        r.timeMs = t;
+        r.channel = quint16(channel);
+        r.value = fields.at(3).trimmed().toDouble(&ok);
+        if (!ok) return false;
+        row.append(r);
+        return true;
+    }
+    for (int i = 3; i + 1 < fields.size(); i += 2) {
+        QByteArray v = fields.at(i).trimmed();
+        if (v.isEmpty()) continue;          // stamp did not answer in this tick
+        AtlasReading r;
+        r.timeMs = t;
+        r.stampId = quint16((i - 3)/2);
+        r.deltaMs = fields.at(i + 1).trimmed().toInt();
+        r.value = v.toDouble(&ok);
+        if (ok) row.append(r);
+    }
+    return true;
+}
+
+/**
+ * @brief Log channel of a probe type name as used in the log header.
+ */
+int LogStore::channelFromName(const QString &name)
+{
+    if (name == "pH") return AtlasReading::chpH;
+    else if (name == "ORP") return AtlasReading::chORP;
+    else if (name == "EC") return AtlasReading::chEC;
+    else if (name == "DO") return AtlasReading::chDO;
+    else if (name == "Temp") return AtlasReading::chTemp;
+    return AtlasReading::chUnknown;
+}
+
+/**
+ * @brief Probe type name of a log channel, the inverse of channelFromName().
+ */
+QString LogStore::channelName(int channel)
+{
+    switch (channel) {
+    case AtlasReading::chpH:
+        return "pH";
+    case AtlasReading::chORP:
+        return "ORP";
+    case AtlasReading::chEC:
+        return "EC";
+    case AtlasReading::chDO:
+        return "DO";
+    case AtlasReading::chTemp:
+        return "Temp";
+    default:
+        return "value";
+    }
+}
+
+//----------------------------------------------------------------
+LogCursor::LogCursor(const LogStore &store, qint64 fromMs, qint64 toMs) :
+    paths(store.files(fromMs, toMs)),
+    fromMs(fromMs),
+    toMs(toMs)
+{
+
+}
+
+/**
+ * @brief The next reading with fromMs <= time <= toMs.
+ *
+ * @return false at the end of the range
+ */
+bool LogCursor::next(AtlasReading &reading)
+{
+    for (;;) {
+        if (isOpen && (dev ? nextCsv(reading) : nextBinary(reading))) return true;
+        if (!openNextFile()) return false;
+    }
+}
+
+/**
+ * @brief Close the current file and open the next one that can be read, positioned at fromMs.
+ */
+bool LogCursor::openNextFile()
+{
+    file.close();
+    buffer.close();
+    reader.close();
+    data.clear();
+    dev = 0;
+    row.clear();
+    rowPos = 0;
+    isOpen = false;
+
+    while (pathNo < paths.size()) {
+        QString path = paths.at(pathNo++);
+        if (path.endsWith(".qz")) {
+            // the index of a compressed segment holds offsets in the uncompressed data
+            QString plain = path.left(path.size() - 3);
+            data = SegmentCompressor::uncompressFile(path);
+            if (data.startsWith("ATLB")) {
+                if (!reader.openBuffer(data)) continue;
+                seekBinary();
+            } else {
+                buffer.setBuffer(&data);
+                buffer.open(QIODevice::ReadOnly);
+                dev = &buffer;
+                seekCsv(LogStore::loadIndex(plain + ".idx"));
+            }
+        } else if (BinLogReader::isBinLog(path)) {
+            if (!reader.open(path)) continue;
+            seekBinary();
+        } else {
+            file.setFileName(path);
+            if (!file.open(QIODevice::ReadOnly)) continue;
+            dev = &file;
+            seekCsv(LogStore::loadIndex(path + ".idx"));
+        }
+        isOpen = true;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Read the header of a CSV log and go to the index entry before fromMs; without index to the first line.
+ */
+void LogCursor::seekCsv(const QVector<LogIndexEntry> &index)
+{
+    // header "# unixTime, yyyy-MM-dd, hh:mm:ss, pH" gives the channel of single stamp logs
+    channel = AtlasReading::chUnknown;
+    QByteArray first = dev->readLine();
+    if (first.startsWith("# unixTime")) {
+        QList<QByteArray> fields = first.split(',');
+        if (fields.size() == 4) channel = LogStore::channelFromName(QString(fields.at(3).trimmed()));
+    }
+
+    qint64 offset = LogStore::seekOffset(index, fromMs);
+    if (offset > dev->pos()) dev->seek(offset);
+}
+
+/**
+ * @brief Go to the block of a binary log that holds fromMs, by binary search.
+ */
+void LogCursor::seekBinary()
+{
+    int lo = 0;
+    int hi = reader.blockCount();
+    while (lo < hi) {   // first block starting after fromMs
+        int mid = (lo + hi)/2;
+        if (reader.block(mid).firstTimeMs() <= fromMs) lo = mid + 1;
+        else hi = mid;
+    }
+    block = qMax(lo - 1, 0);
+    index = 0;
+    column = 0;
+}
+
+/**
+ * @brief Next reading of the current CSV line, or of the next line in the range.
+ *
+ * @return false at the end of the file or the first line after toMs
+ */
+bool LogCursor::nextCsv(AtlasReading &reading)
+{
+    while (rowPos >= row.size()) {
+        if (dev->atEnd()) return false;
+        rowPos = 0;
+        if (!LogStore::parseCsvLine(dev->readLine(), channel, row) || row.isEmpty()) {
+            row.clear();
+            continue;
+        }
+        qint64 t = row.first().timeMs;
+        if (t < fromMs) {
+            row.clear();
+        } else if (t > toMs) {       // the log is in time order
+            row.clear();
+            return false;
+        }
+    }
+    reading = row.at(rowPos++);
+    return true;
+}
+
+/**
+ * @brief Next value of the binary log, within a record column by column.
+ *
+ * Within the first block the start is found by binary search over the time offsets.
+ * @return false at the end of the file or the first record after toMs
+ */
+bool LogCursor::nextBinary(AtlasReading &reading)
+{
+    for (; block < reader.blockCount(); ++block, index = 0, column = 0) {
+        BinLogBlock b = reader.block(block);
+        if (b.count() == 0) continue;
+        if (b.firstTimeMs() > toMs) return false;
+
+        if (index == 0 && column == 0 && fromMs > b.firstTimeMs()) {
+            const quint32 *offsets = b.offsets();
+            quint32 d = quint32(qMin(fromMs - b.firstTimeMs(), qint64(0xffffffff)));
+            index = int(std::lower_bound(offsets, offsets + b.count(), d) - offsets);
+        }
+        for (; index < b.count(); ++index, column = 0) {
+            qint64 t = b.timeMs(index);
+            if (t > toMs) return false;
+            for (; column < reader.columnCount(); ++column) {
+                double v = b.column(column)[index];
+                if (qIsNaN(v)) continue;
+                reading = AtlasReading();
+                reading.timeMs = t;
+                reading.stampId = reader.column(column).stampId;
+                reading.channel = reader.column(column).channel;
+                reading.value = v;
+                ++column;
+                return true;
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,123 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef LOGSTORE_H
+#define LOGSTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QFile>
+#include <QBuffer>
+#include <QSharedPointer>
+#include <functional>
+
+#include "atlasreading.h"
+#include "logmanifest.h"
+#include "binlog.h"
+
+/** @brief Entry of the sparse index "<log>.idx": one per indexInterval records of a CSV log. */
+struct LogIndexEntry {
+    qint64 timeMs;          /**< time of the record, ms since epoch */
+    qint64 offset;          /**< file offset of the line of the record */
+    };
+
+/** @brief Time range queries on CSV logs, binary logs and rotated (manifest) logs.
+ *
+ * CSV logs are entered through their sparse index, binary logs by
+ * binary search over their blocks, rotated logs by the time range of their segments;
+ * only the requested window is read.
+*/
+class LogStore
+{
+public:
+    typedef std::function<bool(const AtlasReading &)> Visitor;  /**< return false to stop */
+
+    explicit LogStore(const QString &fileName);
+
+    bool isValid() const;
+    bool isRotated() const;
+    QString getFileName() const;
+
+    QVector<AtlasReading> query(qint64 fromMs, qint64 toMs, int maxRecords = -1) const;
+    bool scan(qint64 fromMs, qint64 toMs, const Visitor &visit) const;
+    QStringList files(qint64 fromMs, qint64 toMs) const;
+
+    static QVector<LogIndexEntry> loadIndex(const QString &indexFileName);
+    static qint64 seekOffset(const QVector<LogIndexEntry> &index, qint64 fromMs);
+    static bool parseCsvLine(const QByteArray &line, int channel, AtlasReadingRow &row);
+    static int channelFromName(const QString &name);
+    static QString channelName(int channel);
+
+private:
+    QString fileName;
+    QSharedPointer<LogManifest> manifest;   /**< set for rotated logs */
+};
+
+/** @brief Reads the readings of a time range one by one, in file order.
+ *
+ * The current file (segment) stays open at its read position between calls of next(),
+ * so a range read in chunks costs the same as reading it at once.
+*/
+class LogCursor
+{
+public:
+    LogCursor(const LogStore &store, qint64 fromMs, qint64 toMs);
+
+    bool next(AtlasReading &reading);
+
+private:
+    Q_DISABLE_COPY(LogCursor)
+
+    bool openNextFile();
+    void seekCsv(const QVector<LogIndexEntry> &index);
+    void seekBinary();
+    bool nextCsv(AtlasReading &reading);
+    bool nextBinary(AtlasReading &reading);
+
+    QStringList paths;          /**< files with readings in the range, in time order */
+    int pathNo = 0;             /**< next file to open */
+    qint64 fromMs;
+    qint64 toMs;
+    bool isOpen = false;
+
+    QFile file;
+    QByteArray data;            /**< uncompressed ".qz" segment */
+    QBuffer buffer;
+    QIODevice *dev = 0;         /**< CSV: file or buffer; 0 for binary logs */
+    int channel = AtlasReading::chUnknown;
+    AtlasReadingRow row;        /**< CSV: readings of the current line */
+    int rowPos = 0;
+
+    BinLogReader reader;
+    int block = 0;              /**< binary: position of the next value */
+    int index = 0;
+    int column = 0;
+};
+
+#endif // LOGSTORE_H
@@ -0,0 +1,575 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "logwriter.h"
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QtDebug>
+#include <QFileInfo>
+#include <QDir>
+#include <QThreadPool>
+#include <limits>
+
+LogWriter::LogWriter(QObject *parent) :
+    QThread(parent),
+    queue(8192)
+{
+    stopRequested = false;
+    dropped = 0;
+}
+
+LogWriter::~LogWriter()
+{
+    close();
+}
+
+/**
+ * @brief Open a log file and start the writer thread.
+ *
+ * @param fileName
+ * @param header first line of the file
+ * @return false if the writer is already running or the file cannot be opened
+ */
+bool LogWriter::open(const QString &fileName, const QString &header)
+{
+    if (isRunning()) return false;
+
+    QFileInfo fi(fileName);
+    firstFileName = fileName;
+    basePath = fi.dir().absoluteFilePath(fi.completeBaseName());
+    suffix = fi.suffix().isEmpty() ? QString() : "." + fi.suffix();
+    segmentNo = 0;
+    if (rotation.maxBytes > 0 || rotation.period != RotationPolicy::rpNone) {
+        manifest = QSharedPointer<LogManifest>(new LogManifest(basePath + ".manifest"));
+    } else {
+        manifest.clear();
+    }
+
+    this->header = header;
+    batch.clear();
+    batch.reserve(64*1024);
+    unflushed = 0;
+    row.clear();
+    if (!openFile(segmentName())) return false;
+    // summaries cover the whole log, across segments
+    if (rollups) rollup.open(basePath);
+    // recovers a journal left by a crash, new blocks are appended to it
+    if (journaling) journal.open(basePath + ".wal");
+
+    stopRequested = false;
+    dropped = 0;
+    start(QThread::LowPriority);
+    return true;
+}
+
+/**
+ * @brief Open one log file (segment) in the current format.
+ *
+ * Called from open() and, for the next segments, from the writer thread.
+ */
+bool LogWriter::openFile(const QString &fileName)
+{
+    logFile.setFileName(fileName);
+    if (format == lfBinary) {
+        // blocks are updated in place, the file is written from offset 0
+        if (columns.isEmpty()) columns.append(BinLogColumn());
+        if (!logFile.open(QIODevice::WriteOnly)) {
+            qDebug() << "LogWriter: cannot open" << fileName << logFile.errorString();
+            return false;
+        }
+        if (!binWriter.open(&logFile, columns)) {
+            qDebug() << "LogWriter: invalid binary log layout," << columns.size() << "columns";
+            logFile.close();
+            return false;
+        }
+        values.fill(0.0, columns.size());
+    } else if (!logFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qDebug() << "LogWriter: cannot open" << fileName << logFile.errorString();
+        return false;
+    } else {
+        fileBytes = logFile.size();
+        batch.append(header.toUtf8()).append('\n');
+        ++unflushed;
+
+        indexFile.setFileName(fileName + ".idx");
+        if (!indexFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qDebug() << "LogWriter: cannot open" << indexFile.fileName();
+        }
+    }
+    segFirstMs = 0;
+    segLastMs = 0;
+    segRecords = 0;
+    boundaryMs = 0;
+    if (manifest) manifest->setOpen(fileName);
+    return true;
+}
+
+QString LogWriter::segmentName() const
+{
+    if (!manifest) return firstFileName;
+    return basePath + QString("_%1").arg(segmentNo, 4, 10, QChar('0')) + suffix;
+}
+
+/**
+ * @brief Stop the writer thread after it has written all queued records, and close the file.
+ */
+void LogWriter::close()
+{
+    if (!isRunning()) return;
+
+    stopRequested = true;
+    wait();
+}
+
+/**
+ * @brief Queue one reading, written as one line.
+ *
+ * @return false if the queue is full and the reading was dropped
+ */
+bool LogWriter::writeReading(const AtlasReading &reading)
+{
+    if (!isRunning()) return false;
+
+    LogRecord rec;
+    rec.reading = reading;
+    rec.kind = LogRecord::rkReading;
+    if (queue.push(rec)) return true;
+    ++dropped;
+    return false;
+}
+
+/**
+ * @brief Queue the readings of one synchronized tick, written as one aligned line.
+ */
+bool LogWriter::writeRow(const AtlasReadingRow &row)
+{
+    if (!isRunning() || row.isEmpty()) return false;
+
+    // all or nothing: half a row would be merged with the next one
+    if (queue.capacity() - queue.size() < size_t(row.size())) {
+        ++dropped;
+        return false;
+    }
+    LogRecord rec;
+    for (int i = 0; i < row.size(); ++i) {
+        rec.reading = row.at(i);
+        rec.kind = (i == row.size()-1) ? LogRecord::rkRowEnd : LogRecord::rkRowItem;
+        queue.push(rec);
+    }
+    return true;
+}
+
+/**
+ * @brief Queue a comment line, written in order with the readings.
+ */
+bool LogWriter::writeComment(const QString &comment)
+{
+    if (!isRunning()) return false;
+
+    QMutexLocker locker(&commentMutex);
+    LogRecord rec;
+    rec.kind = LogRecord::rkComment;
+    if (!queue.push(rec)) {
+        ++dropped;
+        return false;
+    }
+    comments.append(comment);
+    return true;
+}
+
+/**
+ * @brief Writer thread: drain the queue, format in batches, flush per interval or record count.
+ */
+void LogWriter::run()
+{
+    flushClock.start();
+
+    LogRecord rec;
+    bool stopping = false;
+    while (!stopping) {
+        // read the flag before draining, so records queued before close() are written
+        stopping = stopRequested;
+        while (queue.pop(rec)) {
+            if (needsRotation(rec)) rotate();
+            noteRecord(rec);
+            if (rec.kind != LogRecord::rkComment && rec.reading.deltaMs >= 0) {
+                rollup.add(rec.reading);
+                journal.append(rec.reading);
+            }
+            formatRecord(rec);
+            ++unflushed;
+            if (unflushed >= flushRecords) commit();
+        }
+        if (unflushed > 0 && (stopping || flushClock.elapsed() >= flushIntervalMs)) commit();
+        if (!stopping) msleep(qBound(1, flushIntervalMs/10, 50));
+    }
+    closeSegment();
+    rollup.close();
+    journal.close();
+}
+
+/**
+ * @brief True if rec must go to a new segment: size limit reached or wall-clock boundary passed.
+ *
+ * A segment holds at least one record.
+ */
+bool LogWriter::needsRotation(const LogRecord &rec) const
+{
+    if (!manifest || segRecords == 0) return false;
+
+    if (rotation.maxBytes > 0 && logFile.size() + batch.size() >= rotation.maxBytes) return true;
+    return rec.kind != LogRecord::rkComment && boundaryMs > 0 && rec.reading.timeMs >= boundaryMs;
+}
+
+/**
+ * @brief Keep the time range and record count of the current segment for the manifest.
+ */
+void LogWriter::noteRecord(const LogRecord &rec)
+{
+    if (rec.kind != LogRecord::rkReading && rec.kind != LogRecord::rkRowEnd) return;
+
+    qint64 t = rec.reading.timeMs;
+    if (segRecords == 0) {
+        segFirstMs = t;
+        boundaryMs = nextBoundary(t);
+    }
+    segLastMs = t;
+
+    // sparse index: time and line offset of every indexInterval-th record
+    if (format == lfCsv && indexFile.isOpen() && segRecords % indexInterval == 0) {
+        LogIndexEntry e;
+        e.timeMs = t;
+        e.offset = fileBytes + batch.size();
+        indexBatch.append(reinterpret_cast<const char*>(&e), sizeof(e));
+    }
+    ++segRecords;
+}
+
+/**
+ * @brief Start of the next full hour or day after timeMs (local time), 0 if no period is set.
+ */
+qint64 LogWriter::nextBoundary(qint64 timeMs) const
+{
+    QDateTime dt = QDateTime::fromMSecsSinceEpoch(timeMs);
+    if (rotation.period == RotationPolicy::rpHourly) {
+        return QDateTime(dt.date(), QTime(dt.time().hour(), 0)).addSecs(3600).toMSecsSinceEpoch();
+    } else if (rotation.period == RotationPolicy::rpDaily) {
+        return QDateTime(dt.date().addDays(1), QTime(0, 0)).toMSecsSinceEpoch();
+    }
+    return 0;
+}
+
+/**
+ * @brief Close the current segment and continue in the next one.
+ *
+ * Runs in the writer thread between two records; the compression of the
+ * closed segment runs on a QThreadPool thread, so the writer does not stall.
+ */
+void LogWriter::rotate()
+{
+    closeSegment();
+    ++segmentNo;
+    if (!openFile(segmentName())) {
+        qDebug() << "LogWriter: cannot open next segment, records are lost until the next rotation";
+    }
+}
+
+/**
+ * @brief Write and close the current file; list it as closed in the manifest and compress it.
+ */
+void LogWriter::closeSegment()
+{
+    if (unflushed > 0) commit();
+    checkpoint();
+    logFile.close();
+    indexFile.close();
+    if (!manifest) return;
+    if (segRecords == 0) {
+        manifest->clearOpen();
+        return;
+    }
+
+    LogSegment seg;
+    seg.fileName = logFile.fileName();
+    seg.firstTimeMs = segFirstMs;
+    seg.lastTimeMs = segLastMs;
+    seg.records = segRecords;
+    seg.bytes = QFileInfo(logFile.fileName()).size();
+    int index = manifest->append(seg);
+    if (rotation.compress) {
+        QThreadPool::globalInstance()->start(new SegmentCompressor(manifest, index, logFile.fileName()));
+    }
+}
+
+/**
+ * @brief Append the text of one record to the batch.
+ *
+ * Line format: unixTime, yyyy-MM-dd, hh:mm:ss, value
+ * Aligned rows: unixTime, yyyy-MM-dd, hh:mm:ss.zzz, value0, dt0_ms, value1, dt1_ms, ...
+ */
+void LogWriter::formatRecord(const LogRecord &rec)
+{
+    if (format == lfBinary) {
+        appendBinary(rec);
+        return;
+    }
+    if (rec.kind == LogRecord::rkComment) {
+        QMutexLocker locker(&commentMutex);
+        if (!comments.isEmpty()) batch.append(comments.takeFirst().toUtf8()).append('\n');
+        return;
+    }
+    if (rec.kind == LogRecord::rkRowItem) {
+        row.append(rec.reading);
+        return;
+    }
+
+    const AtlasReading &r = rec.reading;
+    if (rec.kind == LogRecord::rkReading) {
+        fmt.appendTimestamp(batch, r.timeMs);
+        batch.append(", ");
+        fmt.appendValue(batch, r.value, r.channel);
+        batch.append('\n');
+        return;
+    }
+
+    // rkRowEnd
+    row.append(r);
+    fmt.appendTimestamp(batch, row.first().timeMs, true);
+    for (int i = 0; i < row.size(); ++i) {
+        const AtlasReading &ri = row.at(i);
+        if (ri.deltaMs < 0) {
+            batch.append(", , ");
+        } else {
+            batch.append(", ");
+            fmt.appendValue(batch, ri.value, ri.channel);
+            batch.append(", ");
+            fmt.appendInt(batch, ri.deltaMs);
+        }
+    }
+    batch.append('\n');
+    row.clear();
+}
+
+/**
+ * @brief Append one record to the binary log, one value per column.
+ *
+ * Columns without a reading are NaN; comments are not stored in the binary format.
+ */
+void LogWriter::appendBinary(const LogRecord &rec)
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const AtlasReading &r = rec.reading;
+
+    switch (rec.kind) {
+    case LogRecord::rkReading:
+        values.fill(nan);
+        values[columnOf(r.stampId)] = r.value;
+        binWriter.append(r.timeMs, values.constData());
+        break;
+    case LogRecord::rkRowItem:
+        row.append(r);
+        break;
+    case LogRecord::rkRowEnd:
+        row.append(r);
+        values.fill(nan);
+        for (int i = 0; i < row.size(); ++i) {
+            if (row.at(i).deltaMs >= 0) values[columnOf(row.at(i).stampId)] = row.at(i).value;
+        }
+        binWriter.append(row.first().timeMs, values.constData());
+        row.clear();
+        break;
+    default:
+        break;
+    }
+}
+
+int LogWriter::columnOf(quint16 stampId) const
+{
+    for (int c = 0; c < columns.size(); ++c) {
+        if (columns.at(c).stampId == stampId) return c;
+    }
+    return 0;
+}
+
+/**
+ * @brief Write the batch, flush it to the OS and optionally to disk.
+ *
+ * The journal block is written and synced first: one fsync per group commit
+ * makes the readings durable, the log itself is only handed over to the OS.
+ */
+void LogWriter::commit()
+{
+    if (!journal.commit(true)) qDebug() << "LogWriter: journal write failed";
+    if (format == lfBinary) binWriter.commit();
+    rollup.commit();
+    if (!batch.isEmpty()) {
+        logFile.write(batch);
+        fileBytes += batch.size();
+        batch.clear();
+    }
+    logFile.flush();
+    if (!indexBatch.isEmpty()) {
+        // after the log lines, an index entry never points beyond the end of the log
+        indexFile.write(indexBatch);
+        indexFile.flush();
+        indexBatch.clear();
+    }
+    if (syncToDisk) ReadingJournal::syncFile(logFile);
+    if (journal.size() >= checkpointBytes) checkpoint();
+    unflushed = 0;
+    flushClock.restart();
+}
+
+/**
+ * @brief Sync the log to disk, then empty the journal: the log holds all its readings.
+ *
+ * Called when the journal has grown to checkpointBytes and when a segment is closed,
+ * so the journal does not grow with the log.
+ */
+void LogWriter::checkpoint()
+{
+    if (!journal.isOpen()) return;
+    if (!logFile.isOpen() || !ReadingJournal::syncFile(logFile)) return;
+    if (!journal.checkpoint()) qDebug() << "LogWriter: journal checkpoint failed";
+}
+
+// Getters and Setters
+LogWriter::LogFormat LogWriter::getFormat() const
+{
+    return format;
+}
+
+/**
+ * @brief Select CSV or binary format for the next open().
+ */
+void LogWriter::setFormat(LogFormat value)
+{
+    format = value;
+}
+
+LogWriter::RotationPolicy LogWriter::getRotation() const
+{
+    return rotation;
+}
+
+/**
+ * @brief Rotation of the next open(): by size and/or at full hours or days.
+ */
+void LogWriter::setRotation(const RotationPolicy &value)
+{
+    rotation = value;
+}
+
+QVector<BinLogColumn> LogWriter::getColumns() const
+{
+    return columns;
+}
+
+/**
+ * @brief Columns of the binary format for the next open(), one per stamp.
+ */
+void LogWriter::setColumns(const QVector<BinLogColumn> &value)
+{
+    columns = value;
+}
+
+int LogWriter::getFlushIntervalMs() const
+{
+    return flushIntervalMs;
+}
+
+void LogWriter::setFlushIntervalMs(int value)
+{
+    flushIntervalMs = value;
+}
+
+int LogWriter::getIndexInterval() const
+{
+    return indexInterval;
+}
+
+void LogWriter::setIndexInterval(int value)
+{
+    indexInterval = qMax(1, value);
+}
+
+bool LogWriter::getRollups() const
+{
+    return rollups;
+}
+
+/**
+ * @brief Keep rollup tiers (<log>.r1s, .r1m, .r1h) for the next open().
+ */
+void LogWriter::setRollups(bool value)
+{
+    rollups = value;
+}
+
+bool LogWriter::getJournal() const
+{
+    return journaling;
+}
+
+/**
+ * @brief Keep a crash-safe journal (<log>.wal) for the next open().
+ */
+void LogWriter::setJournal(bool value)
+{
+    journaling = value;
+}
+
+int LogWriter::getFlushRecords() const
+{
+    return flushRecords;
+}
+
+void LogWriter::setFlushRecords(int value)
+{
+    flushRecords = value;
+}
+
+bool LogWriter::getSyncToDisk() const
+{
+    return syncToDisk;
+}
+
+void LogWriter::setSyncToDisk(bool value)
+{
+    syncToDisk = value;
+}
+
+quint64 LogWriter::getDropped() const
+{
+    return dropped;
+}
+
+QString LogWriter::getFileName() const
+{
+    return logFile.fileName();
+}
@@ -0,0 +1,171 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include <QThread>
+#include <QFile>
+#include <QMutex>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <atomic>
+
+#include "atlasreading.h"
+#include "spscqueue.h"
+#include "binlog.h"
+#include "logmanifest.h"
+#include "logstore.h"
+#include "logrollup.h"
+#include "readingjournal.h"
+#include "lineformatter.h"
+
+/** @brief Record passed from the GUI thread to the log writer thread. */
+struct LogRecord {
+    enum Kind { rkReading, rkRowItem, rkRowEnd, rkComment };
+
+    AtlasReading reading;   /**< not used for rkComment */
+    int kind = rkReading;   /**< rkRowItem..rkRowEnd: readings of one aligned row */
+    };
+
+class LogWriter : public QThread
+{
+    Q_OBJECT
+
+public:
+    enum LogFormat { lfCsv, lfBinary };
+
+/** @brief When to close the current log file and continue in a new segment. */
+struct RotationPolicy {
+    enum Period { rpNone, rpHourly, rpDaily };
+
+    qint64 maxBytes = 0;    /**< start a new segment at this size, 0: no size limit */
+    int    period = rpNone; /**< start a new segment at each full hour or day */
+    bool   compress = true; /**< compress closed segments in the background */
+    };
+
+    explicit LogWriter(QObject *parent = 0);
+    ~LogWriter();
+
+    bool open(const QString &fileName, const QString &header);
+    void close();
+
+// producer side, called from the GUI thread, never blocks
+    bool writeReading(const AtlasReading &reading);
+    bool writeRow(const AtlasReadingRow &row);
+    bool writeComment(const QString &comment);
+
+// getters
+    LogFormat getFormat() const;
+    QVector<BinLogColumn> getColumns() const;
+    RotationPolicy getRotation() const;
+    int getFlushIntervalMs() const;
+    int getFlushRecords() const;
+    int getIndexInterval() const;
+    bool getRollups() const;
+    bool getJournal() const;
+    bool getSyncToDisk() const;
+    quint64 getDropped() const;
+    QString getFileName() const;
+
+// setters
+    void setFormat(LogFormat value);
+    void setColumns(const QVector<BinLogColumn> &value);
+    void setRotation(const RotationPolicy &value);
+    void setFlushIntervalMs(int value);
+    void setFlushRecords(int value);
+    void setIndexInterval(int value);
+    void setRollups(bool value);
+    void setJournal(bool value);
+    void setSyncToDisk(bool value);
+
+protected:
+    void run();
+
+private:
+    bool openFile(const QString &fileName);
+    QString segmentName() const;
+    bool needsRotation(const LogRecord &rec) const;
+    void noteRecord(const LogRecord &rec);
+    qint64 nextBoundary(qint64 timeMs) const;
+    void rotate();
+    void closeSegment();
+    void checkpoint();
+
+    void formatRecord(const LogRecord &rec);
+    void appendBinary(const LogRecord &rec);
+    int columnOf(quint16 stampId) const;
+    void commit();
+
+    SpscQueue<LogRecord> queue;
+    QMutex commentMutex;
+    QStringList comments;        /**< text of the rkComment records, in queue order */
+    std::atomic<bool> stopRequested;
+    std::atomic<quint64> dropped;
+
+    QFile logFile;
+    QFile indexFile;             /**< CSV format: sparse index "<log>.idx" */
+    QByteArray indexBatch;       /**< index entries not yet written */
+    qint64 fileBytes = 0;        /**< CSV format: bytes written to logFile */
+    LogFormat format = lfCsv;
+    QVector<BinLogColumn> columns;  /**< binary format: one column per stamp */
+    BinLogWriter binWriter;
+    QVector<double> values;      /**< binary format: values of the record being appended */
+    QString header;
+    QByteArray batch;            /**< formatted lines not yet written */
+    LineFormatter fmt;           /**< timestamps and values of the CSV lines */
+    AtlasReadingRow row;         /**< aligned row being collected */
+    QElapsedTimer flushClock;
+    int unflushed = 0;
+
+    int flushIntervalMs = 1000;  /**< flush at least this often while records arrive */
+    int flushRecords = 256;      /**< or after this many records */
+    int indexInterval = 256;     /**< one index entry per this many records */
+    bool syncToDisk = false;     /**< fsync after each flush, not only hand over to the OS */
+
+    RotationPolicy rotation;
+    QSharedPointer<LogManifest> manifest;   /**< null if rotation is off */
+    QString firstFileName;
+    QString basePath;            /**< path without suffix, segments are basePath_NNNN.suffix */
+    QString suffix;
+    int segmentNo = 0;
+    qint64 segFirstMs = 0;
+    qint64 segLastMs = 0;
+    qint64 segRecords = 0;
+    qint64 boundaryMs = 0;       /**< wall-clock time that ends the current segment, 0: none */
+
+    bool rollups = true;         /**< keep 1 s / 1 min / 1 h summaries next to the log */
+    LogRollup rollup;
+
+    bool journaling = true;      /**< keep a checksummed journal "<log>.wal", synced per commit */
+    ReadingJournal journal;
+    qint64 checkpointBytes = 4*1024*1024;   /**< sync the log and empty the journal at this journal size */
+};
+
+#endif // LOGWRITER_H
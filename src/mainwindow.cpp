@@ -31,6 +31,8 @@
 
 #include <QMessageBox>
 #include <QSettings>
+#include <QFileDialog>
+#include <QInputDialog>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -42,6 +44,8 @@ MainWindow::MainWindow(QWidget *parent) :
     pf->move(560,20);
 
     serial = new QSerialPort(this);
+    port = serial;
+    captureReplay = new CaptureReplayDevice(this);
     sd = new SerialDialog(this);
 
     //delayTimer->setSingleShot(true);
@@ -64,12 +68,30 @@ MainWindow::MainWindow(QWidget *parent) :
 
     connect(serial, SIGNAL(readyRead()),
             this, SLOT(readAtlasUSBData2()));
+    connect(captureReplay, SIGNAL(readyRead()),
+            this, SLOT(readAtlasUSBData2()));
+    connect(captureReplay, SIGNAL(finished(qint64,qint64,qint64)),
+            this, SLOT(captureReplayFinished(qint64,qint64,qint64)));
 
     ezof = new EZOFrame(ui->EZOTab);
 
     setupEZOFrames();
 
     logf = new LoggingFrame(ui->logTab);
+
+    live = new StampSource(ezof->stamp, 0, this);
+    replay = new ReplaySource(this);
+    connect( replay, SIGNAL(finished(qint64,qint64)),
+             this, SLOT(replayFinished(qint64,qint64)) );
+    setSource(live);
+
+    // one serial port and one EZO frame per window: the group holds the stamp of this window
+    acq = new AcquisitionGroup(this);
+    acq->addStamp(ezof->stamp);
+    connect( acq, SIGNAL(cmdAvailable(int,QByteArray)),
+             this, SLOT(writeStampData(int,QByteArray)) );
+    connect( acq, SIGNAL(rowReady(AtlasReadingRow)),
+             this, SLOT(logAlignedRow(AtlasReadingRow)) );
     //logf->setLogDir("C:/Data");
     //lf->setLogFile(qs.value("LogFile", "SolTraQ_").toString());
 
@@ -103,10 +125,34 @@ void MainWindow::loadSettings()
     ezof->stamp->setAsSerial(qs.value("Serial", "true").toBool());
     ezof->stamp->setBaud(qs.value("Baud", "9600").toInt());
     ezof->displayBaudrate();
+    // duty cycle of slow-sampling stamps, see SleepScheduler::DutyCyclePolicy
+    SleepScheduler::DutyCyclePolicy dp = ezof->scheduler->getPolicy();
+    dp.periodMs = qs.value("DutyPeriodS", dp.periodMs/1000).toInt()*1000;
+    dp.wakeLatencyMs = qs.value("WakeLatencyMs", dp.wakeLatencyMs).toInt();
+    dp.samples = qs.value("DutySamples", dp.samples).toInt();
+    dp.sampleIntervalMs = qs.value("SampleIntervalMs", dp.sampleIntervalMs).toInt();
+    ezof->scheduler->setPolicy(dp);
     qs.endGroup();
 
     qDebug() << ezof->stamp->getEZOProps().baud;
 
+    qs.beginGroup("Logging");
+    logf->setLogDir(QDir(qs.value("Dir", "C:/Data").toString()));
+    LogWriter::RotationPolicy rp;
+    rp.maxBytes = qs.value("MaxSizeMB", "0").toLongLong()*1024*1024;
+    QString period = qs.value("Rotate", "none").toString();
+    if (period == "hourly") rp.period = LogWriter::RotationPolicy::rpHourly;
+    else if (period == "daily") rp.period = LogWriter::RotationPolicy::rpDaily;
+    rp.compress = qs.value("Compress", "true").toBool();
+    logf->setRotation(rp);
+    logf->setJournal(qs.value("Journal", "true").toBool());
+    qs.endGroup();
+    logf->recoverJournals();
+
+    qs.beginGroup("Plot");
+    pf->setMaxFps(qs.value("MaxFps", "30").toInt());
+    qs.endGroup();
+
     //qs.beginGroup("Tentacle");
     //stepwin->setMainDir(qs.value("Baud", "9600").toInt());
    // sText = qs.value("frequency", "100.0").toString();
@@ -129,6 +175,128 @@ void MainWindow::on_actionConnect_triggered()
     ezof->on_btnInfo_clicked();
 }
 
+/**
+ * @brief Replay a recorded log through the display and plot pipeline.
+ *
+ * Replayed readings are not written to the log, see processReading().
+ */
+void MainWindow::on_actionReplay_triggered()
+{
+    if (replay->isActive()) {
+        replay->stop();
+        return;
+    }
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Replay log"), logf->getLogDir().absolutePath(),
+                                                    tr("Logs (*.log *.alb *.manifest);;All files (*)"));
+    if (fileName.isEmpty()) return;
+    bool ok;
+    double speed = QInputDialog::getDouble(this, tr("Replay log"), tr("Speed (1 = real time, 0 = as fast as possible)"),
+                                           replay->getSpeed(), 0, 100000, 1, &ok);
+    if (!ok) return;
+    if (!replay->open(fileName)) {
+        QMessageBox::critical(this, tr("Error"), tr("Cannot open %1").arg(fileName));
+        return;
+    }
+    replay->setSpeed(speed);
+    setSource(replay);
+    // a log without readings finishes inside start(), replayFinished() went back to live
+    if (!replay->isActive()) {
+        ui->statusBar->showMessage(tr("No readings to replay in %1").arg(fileName));
+        return;
+    }
+    ui->actionReplay->setText(tr("Stop replay"));
+    ui->statusBar->showMessage(tr("Replaying %1").arg(fileName));
+}
+
+/**
+ * @brief Back to the live stamps; the reading rate doubles as a benchmark of the pipeline.
+ */
+void MainWindow::replayFinished(qint64 readings, qint64 elapsedMs)
+{
+    ui->actionReplay->setText(tr("Replay log..."));
+    ui->statusBar->showMessage(tr("Replay: %1 readings in %2 s (%3 readings/s)")
+                               .arg(readings).arg(elapsedMs/1000.0, 0, 'f', 1)
+                               .arg(elapsedMs > 0 ? readings*1000.0/elapsedMs : 0.0, 0, 'f', 0));
+    setSource(live);
+}
+
+/**
+ * @brief Record every serial chunk with its arrival time, for replay with on_actionReplayCapture_triggered().
+ */
+void MainWindow::on_actionCapture_triggered(bool checked)
+{
+    if (!checked) {
+        ui->statusBar->showMessage(tr("Capture: %1 chunks recorded").arg(capture.getChunks()));
+        capture.close();
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this, tr("Capture serial data"),
+                                                    logf->getLogDir().absoluteFilePath("Atlas_" +
+                                                    QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss") + ".cap"),
+                                                    tr("Captures (*.cap)"));
+    if (fileName.isEmpty() || !capture.open(fileName)) {
+        ui->actionCapture->setChecked(false);
+        return;
+    }
+    ui->statusBar->showMessage(tr("Capturing to %1").arg(fileName));
+}
+
+/**
+ * @brief Feed a capture to the parser instead of the serial port, with its original chunks.
+ */
+void MainWindow::on_actionReplayCapture_triggered()
+{
+    if (captureReplay->isOpen()) {
+        captureReplay->close();
+        return;
+    }
+    QString fileName = QFileDialog::getOpenFileName(this, tr("Replay capture"), logf->getLogDir().absolutePath(),
+                                                    tr("Captures (*.cap);;All files (*)"));
+    if (fileName.isEmpty()) return;
+    bool ok;
+    double speed = QInputDialog::getDouble(this, tr("Replay capture"), tr("Speed (1 = real time, 0 = as fast as possible)"),
+                                           captureReplay->getSpeed(), 0, 100000, 1, &ok);
+    if (!ok) return;
+
+    captureReplay->setSpeed(speed);
+    serialbuffer.clear();
+    port = captureReplay;
+    if (!captureReplay->openCapture(fileName)) {
+        port = serial;
+        QMessageBox::critical(this, tr("Error"), tr("%1 is not a capture file").arg(fileName));
+        return;
+    }
+    ui->actionReplayCapture->setText(tr("Stop capture replay"));
+    ui->statusBar->showMessage(tr("Replaying %1").arg(fileName));
+}
+
+void MainWindow::captureReplayFinished(qint64 chunks, qint64 bytes, qint64 elapsedMs)
+{
+    port = serial;
+    serialbuffer.clear();
+    ui->actionReplayCapture->setText(tr("Replay capture..."));
+    ui->statusBar->showMessage(tr("Capture replay: %1 chunks, %2 bytes in %3 s (%4 bytes/s)")
+                               .arg(chunks).arg(bytes).arg(elapsedMs/1000.0, 0, 'f', 1)
+                               .arg(elapsedMs > 0 ? bytes*1000.0/elapsedMs : 0.0, 0, 'f', 0));
+}
+
+/**
+ * @brief Connect the pipeline to another reading source and start it.
+ */
+void MainWindow::setSource(ReadingSource *value)
+{
+    if (source == value) return;
+    if (source) {
+        disconnect( source, SIGNAL(readingAvailable(AtlasReading)),
+                    this, SLOT(processReading(AtlasReading)) );
+        source->stop();
+    }
+    source = value;
+    connect( source, SIGNAL(readingAvailable(AtlasReading)),
+             this, SLOT(processReading(AtlasReading)) );
+    source->start();
+}
+
 void MainWindow::setupEZOFrames()
 {
     connect( ezof, SIGNAL(cmdAvailable(QByteArray)),
@@ -139,6 +307,9 @@ void MainWindow::setupEZOFrames()
 
 MainWindow::~MainWindow()
 {
+    // finish running replays while ui still exists, their finished() slots use it
+    captureReplay->close();
+    replay->stop();
     //delete sd;
     delete ui;
 }
@@ -180,13 +351,26 @@ void MainWindow::closeSerialPort()
 void MainWindow::writeData(const QByteArray &data)
 {
     //qDebug() << data;
-    serial->write(data);
+    port->write(data);
+}
+
+/**
+ * @brief Send a command of the acquisition group to the port of stamp stampId.
+ *
+ * The serial port of this window belongs to the stamp of the EZO frame.
+ */
+void MainWindow::writeStampData(int stampId, const QByteArray &data)
+{
+    if (stampId < 0 || stampId >= acq->stampCount() || acq->getStamp(stampId) != ezof->stamp) {
+        qDebug() << "writeStampData: no port for stamp" << stampId;
+        return;
+    }
+    port->write(data);
 }
 
 void MainWindow::displayAllMeas()
 { 
     QAtlasUSB::EZOProperties pr = ezof->stamp->getEZOProps();
-    double dval = 0;
     QString pt = pr.probeType;
 
     if ( !ui->EZOLabel->text().startsWith(pt) ) {
@@ -203,35 +387,29 @@ void MainWindow::displayAllMeas()
         }
     }
 
-    if (pt == "pH") {
-        dval = pr.currentpH;
+    // value, plot and log are updated from the reading source, see processReading()
+}
+
+/**
+ * @brief Show and plot one reading of the current source (live stamp or replay); log live readings.
+ */
+void MainWindow::processReading(const AtlasReading &r)
+{
+    double dval = r.value;
+    if (r.channel == AtlasReading::chpH) {
         if (dval > 0 && dval < 14) ui->valueLabel->setText(QString::number(dval, 'f', 2 ));
-    } else if (pt == "ORP") {
-        dval = pr.currentORP;
+    } else if (r.channel == AtlasReading::chORP) {
         if (dval > -1021 && dval < 1021) ui->valueLabel->setText(QString::number(dval, 'f', 1 ) + " mV");
+    } else if (r.channel == AtlasReading::chDO) {
+        if (dval >= 0 && dval < 100) ui->valueLabel->setText(QString::number(dval, 'f', 2 ) + " mg/L");
     }
-    pf->realtimeUSBSlot(dval);
-
-    if (isLogging) {
-        //QString line;
-
-        QDateTime dt = QDateTime::currentDateTime();
-        int32_t unixTime = dt.toSecsSinceEpoch();
-        QString dateStr = dt.toString("yyyy-MM-dd");
-        QString timeStr = dt.toString("hh:mm:ss");
-
-        //line.sprintf("%10i, %s, %s, %5.2lf, %5.2lf",
-        //             unixTime, dateStr, timeStr, dval);
-
+    pf->addReading(r);
 
-
-        QString line = QString("%1, %2, %3, %4")
-                .arg(unixTime)
-                .arg(dateStr)
-                .arg(timeStr)
-                .arg(dval);
-
-        logf->write(line);
+    // synchronized readings are logged per tick by logAlignedRow(),
+    // replayed readings are already in a log
+    if (isLogging && source != replay && !acq->isActive()) {
+        // formatting and file I/O are done by the log writer thread
+        logf->writeReading(r);
         if (!commentLine.isEmpty()) {
             logf-> write(commentLine);
             commentLine.clear();
@@ -241,7 +419,8 @@ void MainWindow::displayAllMeas()
 
 void MainWindow::readAtlasUSBData2()
 {
-    QByteArray chunk = serial->readAll();
+    QByteArray chunk = port->readAll();
+    if (capture.isOpen() && port == serial) capture.record(chunk);
     serialbuffer.append(chunk);
 
     while ( serialbuffer.contains("\r") ) {
@@ -261,8 +440,14 @@ void MainWindow::readAtlasUSBData2()
         else if ( response.contains("*UV") ) ui->statusBar->showMessage("Under Voltage");
         else if ( response.contains("*RS") ) ui->statusBar->showMessage("Device Reset");
         else if ( response.contains("*RE") ) ui->statusBar->showMessage("Boot up Completed");
-        else if ( response.contains("*SL") ) ui->statusBar->showMessage("Device Asleep");
-        else if ( response.contains("*WA") ) ui->statusBar->showMessage("Device Woken Up");
+        else if ( response.contains("*SL") ) {
+            // duty cycled stamps report this every cycle, keep them off the status bar
+            if ( !ezof->scheduler->isActive() ) ui->statusBar->showMessage("Device Asleep");
+        }
+        else if ( response.contains("*WA") ) {
+            if ( ezof->scheduler->isActive() ) ezof->scheduler->stampWoke();
+            else ui->statusBar->showMessage("Device Woken Up");
+        }
         else ezof->stamp->parseAtlasUSB(response);
     }
 }
@@ -313,7 +498,27 @@ void MainWindow::on_btnLogStart_clicked()
 {
     QDateTime datetime(QDateTime::currentDateTime());
     QString dtString = datetime.toString("yyyyMMdd_hhmmss");
-    logf->setLogFile("C:/Data/Atlas_" + dtString + ".log");
+    // relative to the log directory of the ini file
+    logf->setLogFile("Atlas_" + dtString + (logf->isBinary() ? ".alb" : ".log"));
+
+    QVector<BinLogColumn> columns;
+    if (ui->cbSync->isChecked()) {
+        QString header = "# unixTime, yyyy-MM-dd, hh:mm:ss.zzz";
+        for (int i = 0; i < acq->stampCount(); ++i) {
+            header += QString(", value%1, dt%1_ms").arg(i);
+            BinLogColumn col;
+            col.stampId = quint16(i);
+            col.channel = quint16(acq->getStamp(i)->getChannel());
+            columns.append(col);
+        }
+        logf->setHeader(header);
+    } else {
+        logf->setHeader("# unixTime, yyyy-MM-dd, hh:mm:ss, " + ezof->stamp->getEZOProps().probeType);
+        BinLogColumn col;
+        col.channel = quint16(ezof->stamp->getChannel());
+        columns.append(col);
+    }
+    logf->setColumns(columns);
 
     logf->on_btnStart_clicked();
     isLogging = true;
@@ -330,3 +535,30 @@ void MainWindow::on_btnLogStop_clicked()
     ui->btnLogStart->setEnabled(true);
     ui->btnLogStop->setEnabled(false);
 }
+
+/**
+ * @brief Synchronized acquisition: all stamps of the group are read on a common clock.
+ *
+ * AutoRead and duty cycling of the EZO frame are switched off and locked while it runs.
+ */
+void MainWindow::on_cbSync_clicked(bool checked)
+{
+    if (checked) {
+        ezof->setReadLocked(true);
+        acq->start();
+    } else {
+        acq->stop();
+        ezof->setReadLocked(false);
+    }
+}
+
+void MainWindow::logAlignedRow(const AtlasReadingRow &row)
+{
+    if (isLogging) {
+        logf->writeRow(row);
+        if (!commentLine.isEmpty()) {
+            logf->write(commentLine);
+            commentLine.clear();
+        }
+    }
+}
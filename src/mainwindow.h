@@ -43,6 +43,10 @@
 #include "about.h"
 #include "serialdialog.h"
 #include "loggingframe.h"
+#include "acquisitiongroup.h"
+#include "readingsource.h"
+#include "replaysource.h"
+#include "serialcapture.h"
 
 QT_BEGIN_NAMESPACE
 
@@ -66,18 +70,25 @@ private slots:
     void handleError(QSerialPort::SerialPortError error);
 
     void writeData(const QByteArray &data);
+    void writeStampData(int stampId, const QByteArray &data);
     void readAtlasUSBData2();
 
     void setupEZOFrames();
 
     void on_action_Help_Tentacle_triggered();
     void displayAllMeas();
+    void processReading(const AtlasReading &r);
+    void replayFinished(qint64 readings, qint64 elapsedMs);
     void on_contCB_clicked(bool checked);
     void on_actionScreenshot_triggered();
 
     void on_actionAbout_AtlasTerminal_triggered();
     void on_actionAbout_Qt_triggered();
     void on_actionConnect_triggered();
+    void on_actionReplay_triggered();
+    void on_actionCapture_triggered(bool checked);
+    void on_actionReplayCapture_triggered();
+    void captureReplayFinished(qint64 chunks, qint64 bytes, qint64 elapsedMs);
 
 // functions for QSettings  and use of inifiles
     void loadSettings();
@@ -89,19 +100,31 @@ private slots:
 
     void on_btnLogStop_clicked();
 
+    void on_cbSync_clicked(bool checked);
+    void logAlignedRow(const AtlasReadingRow &row);
+
 private:
+    void setSource(ReadingSource *value);
+
     Ui::MainWindow *ui;
 
     QString m_sSettingsFile;
 
     SerialDialog* sd;
     QSerialPort *serial;
+    QIODevice *port;            /**< serial, or captureReplay while a capture is replayed */
+    SerialCapture capture;
+    CaptureReplayDevice* captureReplay;
     QByteArray lastCmd;
     QByteArray serialbuffer;
 
     EZOFrame* ezof;
     PlotFrame* pf;
     LoggingFrame* logf;
+    AcquisitionGroup* acq;
+    ReadingSource* source = 0;  /**< live or replay, feeds processReading() */
+    StampSource* live;
+    ReplaySource* replay;
     QString commentLine;
 
     //QTimer* delayTimer;
@@ -35,6 +35,10 @@ PlotFrame::PlotFrame(QWidget *parent) :
 {
     ui->setupUi(this);
     dataTimer = new QTimer(this);
+    frameTimer = new QTimer(this);
+    frameTimer->setSingleShot(true);
+    connect(frameTimer, SIGNAL(timeout()), this, SLOT(replotFrame()));
+    frameClock.start();
     xSpan = ui->sbSpan->value();
 
     setupPlot3();
@@ -125,25 +129,7 @@ void PlotFrame::setupPlot2()
 
 void PlotFrame::setupPlot3()
 {
-    ui->customPlot->addGraph(); // blue line
-    ui->customPlot->graph(0)->setPen(QPen(Qt::blue));
-    //ui->customPlot->graph(0)->setBrush(QBrush(QColor(240, 255, 200)));
-    ui->customPlot->graph(0)->setAntialiasedFill(false);
-
-    ui->customPlot->addGraph(); // red line
-    ui->customPlot->graph(1)->setPen(QPen(Qt::red));
-    //ui->customPlot->graph(0)->setChannelFillGraph(ui->customPlot->graph(1));
-
-    ui->customPlot->addGraph(); // blue dot
-    ui->customPlot->graph(2)->setPen(QPen(Qt::blue));
-    ui->customPlot->graph(2)->setLineStyle(QCPGraph::lsNone);
-    ui->customPlot->graph(2)->setScatterStyle(QCPScatterStyle::ssDisc);
-
-    ui->customPlot->addGraph(); // red dot
-    ui->customPlot->graph(3)->setPen(QPen(Qt::red));
-    ui->customPlot->graph(3)->setLineStyle(QCPGraph::lsNone);
-    ui->customPlot->graph(3)->setScatterStyle(QCPScatterStyle::ssDisc);
-
+// graphs and value axes are created per stamp, see traceFor()
 // configure x-axis
     ui->customPlot->xAxis->setTickLabelType(QCPAxis::ltDateTime);
     ui->customPlot->xAxis->setDateTimeFormat("hh:mm:ss");
@@ -158,6 +144,22 @@ void PlotFrame::setupPlot3()
 // configure y-axis
     ui->customPlot->yAxis->setRange(yMin, yMax);
 
+// only the data and the key axis scroll, the other layers are kept in buffers
+// and redrawn only when they change (e.g. a rescaled value axis):
+    ui->customPlot->addLayer("valueAxes", ui->customPlot->layer("axes"));
+    ui->customPlot->yAxis->setLayer("valueAxes");
+    ui->customPlot->yAxis2->setLayer("valueAxes");
+    ui->customPlot->layer("valueAxes")->setMode(QCPLayer::lmBuffered);
+    ui->customPlot->layer("background")->setMode(QCPLayer::lmBuffered);
+    ui->customPlot->layer("legend")->setMode(QCPLayer::lmBuffered);
+
+// grid and data scroll with the x-axis: their buffers are shifted and only
+// the exposed strip and the new readings are drawn, see replotFrame()
+    ui->customPlot->layer("grid")->setMode(QCPLayer::lmBuffered);
+    ui->customPlot->layer("grid")->setScrollAxis(ui->customPlot->xAxis);
+    ui->customPlot->layer("main")->setMode(QCPLayer::lmBuffered);
+    ui->customPlot->layer("main")->setScrollAxis(ui->customPlot->xAxis);
+
 // complete box around plot and
 // make left and bottom axes transfer their ranges to right and top axes:
     ui->customPlot->axisRect()->setupFullAxesBox();
@@ -178,100 +180,229 @@ void PlotFrame::realtimeDataSlot()
     double key = QDateTime::currentDateTime().toMSecsSinceEpoch()/1000.0;
     static double lastPointKey = 0;
     if (key-lastPointKey > 0.01) {// at most add point every 10 ms
-        double value0 = qSin(key); //qSin(key*1.6+qCos(key*1.7)*2)*10 + qSin(key*1.2+0.56)*20 + 26;
-        double value1 = qCos(key); //qSin(key*1.3+qCos(key*1.2)*1.2)*7 + qSin(key*0.9+0.26)*24 + 26;
-// add data to lines:
-        ui->customPlot->graph(0)->addData(key, value0);
-        ui->customPlot->graph(1)->addData(key, value1);
-// set data of dots:
-        ui->customPlot->graph(2)->clearData();
-        ui->customPlot->graph(2)->addData(key, value0);
-        ui->customPlot->graph(3)->clearData();
-        ui->customPlot->graph(3)->addData(key, value1);
-// remove data of lines that's outside visible range:
-        ui->customPlot->graph(0)->removeDataBefore(key-8);
-        ui->customPlot->graph(1)->removeDataBefore(key-8);
-// rescale value (vertical) axis to fit the current data:
-        ui->customPlot->graph(0)->rescaleValueAxis();
-        ui->customPlot->graph(1)->rescaleValueAxis(true);
+        AtlasReading r;
+        r.timeMs = qint64(key*1000);
+        r.value = qSin(key); //qSin(key*1.6+qCos(key*1.7)*2)*10 + qSin(key*1.2+0.56)*20 + 26;
+        addReading(r);
+        r.stampId = 1;
+        r.value = qCos(key); //qSin(key*1.3+qCos(key*1.2)*1.2)*7 + qSin(key*0.9+0.26)*24 + 26;
+        addReading(r);
         lastPointKey = key;
     }
-// make key axis range scroll with the data (at a constant range size of 8):
-    ui->customPlot->xAxis->setRange(key+0.25, 8, Qt::AlignRight);
-    ui->customPlot->replot();
-
-// calculate frames per second:
-    static double lastFpsKey;
-    static int frameCount;
-    ++frameCount;
-    if (key-lastFpsKey > 2) {       // average fps over 2 seconds
-       // ui->statusBar->showMessage(
-       // QString("%1 FPS, Total Data points: %2")
-        //.arg(frameCount/(key-lastFpsKey), 0, 'f', 0)
-       // .arg(ui->customPlot->graph(0)->data()->count()+ui->customPlot->graph(1)->data()->count())
-        //, 0);
-        lastFpsKey = key;
-        frameCount = 0;
-    }
 }
 
 void PlotFrame::realtimeTentacleSlot(double value0)
 {
-// calculate two new data points:
-    double key = QDateTime::currentDateTime().toMSecsSinceEpoch()/1000.0;
-
-    value0 = value0 + (rand() % 100)/1000.0;
-
-// add data to lines:
-        ui->customPlot->graph(0)->addData(key, value0);
-
-// set data of dots:
-        ui->customPlot->graph(2)->clearData();
-        ui->customPlot->graph(2)->addData(key, value0);
-
-// remove data of lines that's outside visible range:
-        ui->customPlot->graph(0)->removeDataBefore(key-120);
+    AtlasReading r;
+    r.timeMs = QDateTime::currentMSecsSinceEpoch();
+    r.channel = AtlasReading::chpH;
+    r.value = value0 + (rand() % 100)/1000.0;
+    addReading(r);
+}
 
-// rescale value (vertical) axis to fit the current data:
-        //ui->customPlot->graph(0)->rescaleValueAxis();
-        //ui->customPlot->graph(1)->rescaleValueAxis(true);
-// make key axis range scroll with the data (at a constant range size of 60):
-    ui->customPlot->xAxis->setRange(key+2, 120, Qt::AlignRight);
-    ui->customPlot->replot();
+/**
+ * @brief Add a reading to the graph of its stamp.
+ *
+ * The reading is only queued; replotFrame() draws the queued readings of
+ * all stamps in one replot, at most maxFps times per second.
+ * Replayed readings keep their logged time.
+ */
+void PlotFrame::addReading(const AtlasReading &r)
+{
+    StampTrace &t = traceFor(r);
+    double key = r.timeMs/1000.0;
+    if (key > t.lastKey && t.lastKey > 0) t.sampleInterval += 0.1*((key - t.lastKey) - t.sampleInterval);
+    t.lastKey = key;
+    t.pendingKeys.append(key);
+    t.pendingValues.append(r.value);
+    scheduleReplot();
 }
 
-void PlotFrame::realtimeUSBSlot(double value)
+/**
+ * @brief Start the frame timer, so the next replot is at least frameMs after the last one.
+ */
+void PlotFrame::scheduleReplot()
 {
-// calculate two new data points:
-    double key = QDateTime::currentDateTime().toMSecsSinceEpoch()/1000.0;
+    dirty = true;
+    if (frameTimer->isActive()) return;
+    frameTimer->start(int(qMax(frameMs - frameClock.elapsed(), qint64(0))));
+}
 
-    //value = value + (rand() % 100)/1000.0;
+/**
+ * @brief One display frame: add the queued readings of all stamps and replot once.
+ */
+void PlotFrame::replotFrame()
+{
+    if (!dirty) return;
+    dirty = false;
+
+    double key = ui->customPlot->xAxis->range().upper - 0.02*xSpan;
+    bool added = false;
+    QCPLayer *dataLayer = ui->customPlot->layer("main");
+    for (QMap<int, StampTrace>::iterator it = traces.begin(); it != traces.end(); ++it) {
+        StampTrace &t = it.value();
+        if (t.pendingKeys.isEmpty()) continue;
+        if (!added || t.pendingKeys.last() > key) key = t.pendingKeys.last();
+        added = true;
+
+// redraw from the previous last point (line segment to the new readings, old dot):
+        const RingSeries &plotted = t.line->data();
+        dataLayer->markDirtyFrom(plotted.isEmpty() ? t.pendingKeys.first() : plotted.key(plotted.size() - 1));
 
 // add data to lines:
-    ui->customPlot->graph(0)->addData(key, value);
+        updateCapacity(t);
+        t.line->addData(t.pendingKeys, t.pendingValues);
 
 // set data of dots:
-    ui->customPlot->graph(2)->clearData();
-    ui->customPlot->graph(2)->addData(key, value);
+        t.dot->clearData();
+        t.dot->addData(t.pendingKeys.last(), t.pendingValues.last());
+        t.pendingKeys.clear();
+        t.pendingValues.clear();
+    }
 
 // remove data of lines that's outside visible range:
-    ui->customPlot->graph(0)->removeDataBefore(key-xSpan);
-
-// rescale value (vertical) axis to fit the current data:
-    //ui->customPlot->yAxis->setRange(-1000, 1000);
+    for (QMap<int, StampTrace>::iterator it = traces.begin(); it != traces.end(); ++it) {
+        it.value().line->removeDataBefore(key-xSpan);
+    }
 
-    //ui->customPlot->graph(0)->rescaleValueAxis();
-    //ui->customPlot->graph(1)->rescaleValueAxis(true);
+// rescale the value axes of the units without a fixed range:
+    for (QMap<int, QCPAxis*>::const_iterator it = unitAxes.constBegin(); it != unitAxes.constEnd(); ++it) {
+        if (it.key() == AtlasReading::chpH) continue;
+        bool first = true;
+        for (QMap<int, StampTrace>::const_iterator t = traces.constBegin(); t != traces.constEnd(); ++t) {
+            if (t.value().line->valueAxis() != it.value()) continue;
+            t.value().line->rescaleValueAxis(!first);
+            first = false;
+        }
+    }
 
-// make key axis range scroll with the data (at a constant range size of xSpan):
-    ui->customPlot->xAxis->setRange(key+0.02*xSpan, xSpan, Qt::AlignRight);
+// make key axis range scroll with the data (at a constant range size of xSpan),
+// by whole pixels so the scrolling layers can shift their buffers:
+    double upper = key+0.02*xSpan;
+    int width = ui->customPlot->axisRect()->width();
+    if (width > 0) upper = std::ceil(upper*width/xSpan)*xSpan/width;
+    ui->customPlot->xAxis->setRange(upper, xSpan, Qt::AlignRight);
 
     ui->customPlot->replot();
+    frameClock.restart();
+}
+
+/**
+ * @brief Graph of the stamp of r; the first reading of a stamp creates it.
+ */
+StampTrace &PlotFrame::traceFor(const AtlasReading &r)
+{
+    QMap<int, StampTrace>::iterator it = traces.find(r.stampId);
+    if (it != traces.end()) return it.value();
+
+    static const Qt::GlobalColor colors[] = { Qt::blue, Qt::red, Qt::darkGreen, Qt::magenta,
+                                              Qt::darkCyan, Qt::darkYellow, Qt::darkRed, Qt::darkBlue };
+    QColor color = colors[traces.size() % 8];
+
+    StampTrace t;
+    t.channel = r.channel;
+    QCPAxis *valueAxis = axisFor(r.channel);
+    t.line = new RealtimeGraph(ui->customPlot->xAxis, valueAxis);
+    ui->customPlot->addPlottable(t.line);
+    t.line->setPen(QPen(color));
+    t.line->setName(QString("Stamp %1 %2").arg(r.stampId).arg(unitName(r.channel)).trimmed());
+
+    t.dot = ui->customPlot->addGraph(ui->customPlot->xAxis, valueAxis);
+    t.dot->setPen(QPen(color));
+    t.dot->setLineStyle(QCPGraph::lsNone);
+    t.dot->setScatterStyle(QCPScatterStyle::ssDisc);
+    t.dot->removeFromLegend();
+
+    it = traces.insert(r.stampId, t);
+    updateCapacity(it.value());
+    ui->customPlot->legend->setVisible(traces.size() > 1);
+    return it.value();
+}
+
+/**
+ * @brief Value axis of a unit: left for the first unit, right for the second, more on the right.
+ */
+QCPAxis *PlotFrame::axisFor(int channel)
+{
+    QMap<int, QCPAxis*>::const_iterator it = unitAxes.constFind(channel);
+    if (it != unitAxes.constEnd()) return it.value();
+
+    QCPAxisRect *rect = ui->customPlot->axisRect();
+    QCPAxis *axis;
+    if (unitAxes.isEmpty()) {
+        axis = ui->customPlot->yAxis;
+    } else if (unitAxes.size() == 1) {
+        // yAxis2 no longer mirrors yAxis, it gets a unit of its own
+        disconnect(ui->customPlot->yAxis, SIGNAL(rangeChanged(QCPRange)),
+                   ui->customPlot->yAxis2, SLOT(setRange(QCPRange)));
+        axis = ui->customPlot->yAxis2;
+        axis->setTicks(true);
+        axis->setTickLabels(true);
+    } else {
+        axis = rect->addAxis(QCPAxis::atRight);
+        axis->setLayer("valueAxes");
+    }
+    axis->setLabel(unitName(channel));
+    if (channel == AtlasReading::chpH) axis->setRange(yMin, yMax);
+    unitAxes.insert(channel, axis);
+    return axis;
+}
+
+/**
+ * @brief Size the ring buffer of a stamp's line for the span at its sample rate.
+ *
+ * Only reallocates when the window no longer fits or uses less than a quarter of the buffer.
+ */
+void PlotFrame::updateCapacity(StampTrace &t)
+{
+    double points = xSpan/qMax(t.sampleInterval, 1e-4)*1.25 + 64;
+    int needed = int(qBound(256.0, points, double(1 << 22)));
+    if (needed > t.line->data().capacity() || 4*needed < t.line->data().capacity()) {
+        t.line->setCapacity(needed);
+    }
+}
+
+/**
+ * @brief Axis label of a log channel.
+ */
+QString PlotFrame::unitName(int channel)
+{
+    switch (channel) {
+    case AtlasReading::chpH:
+        return "pH";
+    case AtlasReading::chORP:
+        return "mV";
+    case AtlasReading::chEC:
+        return QString::fromUtf8("\xc2\xb5S/cm");
+    case AtlasReading::chDO:
+        return "mg/L";
+    case AtlasReading::chTemp:
+        return QString::fromUtf8("\xc2\xb0" "C");
+    default:
+        return QString();
+    }
 }
 
 void PlotFrame::on_sbSpan_valueChanged(int arg1)
 {
     xSpan = double(arg1);
+    for (QMap<int, StampTrace>::iterator it = traces.begin(); it != traces.end(); ++it) {
+        updateCapacity(it.value());
+    }
+    scheduleReplot();
+}
+
+int PlotFrame::getMaxFps() const
+{
+    return 1000/frameMs;
+}
+
+/**
+ * @brief Maximum replots per second; readings arriving faster are drawn together.
+ */
+void PlotFrame::setMaxFps(int value)
+{
+    frameMs = 1000/qBound(1, value, 1000);
 }
 
 void PlotFrame::setYMinMax(double valMin, double valMax)
@@ -30,13 +30,28 @@
 #define PLOTFRAME_H
 
 #include <QFrame>
+#include <QTimer>
+#include <QElapsedTimer>
 #include "thirdparty/qcustomplot.h"
 #include "ezoframe.h"
+#include "realtimegraph.h"
+#include "atlasreading.h"
 
 namespace Ui {
 class PlotFrame;
 }
 
+/** @brief Plot objects and queued readings of one stamp. */
+struct StampTrace {
+    RealtimeGraph* line = 0;    /**< scrolling window of the readings */
+    QCPGraph* dot = 0;          /**< latest reading */
+    int channel = 0;            /**< probe type, selects the value axis */
+    double lastKey = 0;
+    double sampleInterval = 1;  /**< average time between readings, s */
+    QVector<double> pendingKeys;    /**< readings not plotted yet */
+    QVector<double> pendingValues;
+    };
+
 class PlotFrame : public QFrame
 {
     Q_OBJECT
@@ -47,24 +62,40 @@ public:
 
     void setYMinMax(double valMin, double valMax);
 
+    int getMaxFps() const;
+    void setMaxFps(int value);
+
 public slots:
     void realtimeTentacleSlot(double value0);
-    void realtimeUSBSlot(double value);
+    void addReading(const AtlasReading &r);
 
 private slots:
     void setupPlot();
     void setupPlot2();
     void setupPlot3();
     void realtimeDataSlot();
+    void replotFrame();
 
 
     void on_sbSpan_valueChanged(int arg1);
 
 private:
+    void scheduleReplot();
+    StampTrace &traceFor(const AtlasReading &r);
+    QCPAxis *axisFor(int channel);
+    void updateCapacity(StampTrace &t);
+    static QString unitName(int channel);
+
     Ui::PlotFrame *ui;
 
     QCPPlotTitle* plotTitle;
+    QMap<int, StampTrace> traces;   /**< by stamp id */
+    QMap<int, QCPAxis*> unitAxes;   /**< value axis by channel (unit) */
     QTimer* dataTimer;
+    QTimer* frameTimer;         /**< single shot, runs only while there is something to draw */
+    QElapsedTimer frameClock;   /**< time since the last replot */
+    int frameMs = 33;           /**< minimum time between replots, 1000/maxFps */
+    bool dirty = false;
     double xSpan = 1;
     double yMin = 0;
     double yMax = 14;
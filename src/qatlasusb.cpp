@@ -354,6 +354,19 @@ QByteArray QAtlasUSB::sleep()
     lastEZOCmd = cmd;
     return cmd;
 }
+/**
+ * @brief Wake the EZO stamp from sleep (low power mode).
+ *
+ * Any character wakes the stamp, a single <CR> is used
+ * so that no command is executed.
+ * Response: *WA
+ */
+QByteArray QAtlasUSB::wake()
+{
+    QByteArray cmd = "\r";
+    lastEZOCmd = cmd;
+    return cmd;
+}
 
 //---------------------------------------
 /**
@@ -422,6 +435,10 @@ void QAtlasUSB::parseAtlasUSB(QByteArray atlasdata)
             props.probeType = QString(t);     // EZO "pH" stamp
             t = atlasdata.mid(6,4);
             props.version = QString(t);
+        } else if (atlasdata.startsWith("?I,D.O.,")) {
+            props.probeType = "DO";             // EZO "D.O." stamp
+            t = atlasdata.mid(8,4);
+            props.version = QString(t);
         } else {
             t = atlasdata.mid(3,3);              // EZO "ORP" stamp
             props.probeType = QString(t);
@@ -447,6 +464,10 @@ void QAtlasUSB::parseAtlasUSB(QByteArray atlasdata)
         } else if (props.probeType == "ORP") {
             props.currentORP = t.toDouble();
             if ( props.currentORP > -1021 && props.currentORP < 1021 ) emit measRead();
+        } else if (props.probeType == "DO") {
+            // "mg/L" or "mg/L,%sat" when the saturation output is enabled
+            props.currentDO = atlasdata.split(',').first().toDouble();
+            if ( props.currentDO >= 0 && props.currentDO < 100 ) emit measRead();
         }
     }
 }
@@ -457,6 +478,30 @@ QAtlasUSB::EZOProperties QAtlasUSB::getEZOProps() const
     return props;
 }
 
+/**
+ * @brief Last measurement value of the stamp, in the unit of its probe type.
+ */
+double QAtlasUSB::getCurrentValue() const
+{
+    if (props.probeType == "pH") return props.currentpH;
+    else if (props.probeType == "ORP") return props.currentORP;
+    else if (props.probeType == "EC") return props.currentEC;
+    else if (props.probeType == "DO") return props.currentDO;
+    return 0.0;
+}
+
+/**
+ * @brief Log channel of the stamp, derived from its probe type.
+ */
+AtlasReading::Channel QAtlasUSB::getChannel() const
+{
+    if (props.probeType == "pH") return AtlasReading::chpH;
+    else if (props.probeType == "ORP") return AtlasReading::chORP;
+    else if (props.probeType == "EC") return AtlasReading::chEC;
+    else if (props.probeType == "DO") return AtlasReading::chDO;
+    return AtlasReading::chUnknown;
+}
+
 void QAtlasUSB::setEZOProps(const EZOProperties &value)
 {
     props = value;
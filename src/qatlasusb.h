@@ -31,6 +31,8 @@
 
 #include <QObject>
 
+#include "atlasreading.h"
+
 class QAtlasUSB : public QObject
 {
     Q_OBJECT
@@ -48,6 +50,7 @@ struct EZOProperties {
     double  currentpH = 7.0;      /**< pH measurement */
     double  currentORP = -999.9;  /**< ORP measurement */
     double  currentEC = -1.0;     /**< EC measurement */
+    double  currentDO = -1.0;     /**< DO measurement, mg/L */
     double  currentTemp = -273.0; /**< Temperature */
     int     calState = -1;        /**< Calibration state: 0,1,2,3 (uncal, mid, low, high) */
     double  acidSlope = 0.0;      /**< Calibration slope pH < 7 */
@@ -64,6 +67,8 @@ struct EZOProperties {
 
 // getters
     EZOProperties getEZOProps() const;
+    double getCurrentValue() const;
+    AtlasReading::Channel getChannel() const;
 
 // setters
     void setEZOProps(const EZOProperties &value);
@@ -90,6 +95,7 @@ public slots:
     QByteArray readStatus();
 
     QByteArray sleep();
+    QByteArray wake();
     QByteArray changeSerial(int baudrate); // change baudrate in UART mode
     QByteArray factoryReset();
 
@@ -0,0 +1,261 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "readingjournal.h"
+#include <QtDebug>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(JournalBlockHeader) == 16, "journal block header must be 16 bytes");
+static_assert(sizeof(AtlasReading) == 24, "journal records are 24 byte readings");
+
+ReadingJournal::ReadingJournal()
+{
+
+}
+
+ReadingJournal::~ReadingJournal()
+{
+    close();
+}
+
+/**
+ * @brief Recover the journal, then open it for appending.
+ *
+ * New blocks continue the sequence numbers of the recovered journal.
+ * The file is unbuffered: a failed write leaves nothing behind in a buffer
+ * that a later write could append after the torn block.
+ */
+bool ReadingJournal::open(const QString &fileName)
+{
+    close();
+    Recovery rec = recover(fileName);
+    if (rec.truncatedBytes > 0) {
+        qDebug() << "ReadingJournal:" << fileName << "torn tail of" << rec.truncatedBytes << "bytes removed";
+    }
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) {
+        qDebug() << "ReadingJournal: cannot open" << fileName << file.errorString();
+        return false;
+    }
+    seq = rec.lastSeq;
+    validBytes = rec.validBytes;
+    openSeq = seq;
+    openBytes = validBytes;
+    payload.clear();
+    count = 0;
+    return true;
+}
+
+bool ReadingJournal::isOpen() const
+{
+    return file.isOpen();
+}
+
+/**
+ * @brief Size of the complete blocks in the journal, in bytes.
+ */
+qint64 ReadingJournal::size() const
+{
+    return validBytes;
+}
+
+/**
+ * @brief Add a reading to the next block; nothing is written until commit().
+ */
+void ReadingJournal::append(const AtlasReading &reading)
+{
+    if (!file.isOpen()) return;
+    payload.append(reinterpret_cast<const char*>(&reading), sizeof(AtlasReading));
+    ++count;
+}
+
+/**
+ * @brief Write the collected records as one block and (optionally) fsync.
+ *
+ * Header and records go out in one write, one fsync covers the whole group.
+ * If the block cannot be written completely it is cut off again; the records
+ * stay collected and go out with the next commit.
+ */
+bool ReadingJournal::commit(bool sync)
+{
+    if (!file.isOpen() || count == 0) return true;
+
+    JournalBlockHeader h;
+    std::memcpy(h.magic, "AJRN", 4);
+    h.seq = seq + 1;
+    h.count = count;
+    h.crc = crc32(payload.constData(), payload.size());
+
+    QByteArray block(reinterpret_cast<const char*>(&h), sizeof(h));
+    block.append(payload);
+    if (file.write(block) != block.size() || !file.flush() || (sync && !syncFile(file))) {
+        if (!file.resize(validBytes)) {
+            qDebug() << "ReadingJournal: cannot remove torn block," << file.fileName() << "closed";
+            file.close();
+        }
+        return false;
+    }
+
+    seq = h.seq;
+    validBytes += block.size();
+    payload.clear();
+    count = 0;
+    return true;
+}
+
+/**
+ * @brief Remove the blocks written since open(), once their readings are on disk in the log.
+ *
+ * Blocks recovered by open() are kept: they may hold readings of a crashed session
+ * that never reached the log. Records collected since the last commit() are kept.
+ */
+bool ReadingJournal::checkpoint()
+{
+    if (!file.isOpen() || validBytes == openBytes) return true;
+    if (!file.resize(openBytes) || !syncFile(file)) return false;
+    seq = openSeq;
+    validBytes = openBytes;
+    return true;
+}
+
+void ReadingJournal::close()
+{
+    if (!file.isOpen()) return;
+    commit(true);
+    file.close();
+}
+
+/**
+ * @brief Check all blocks and cut off a torn or corrupt tail.
+ *
+ * Scanning stops at the first block with a wrong magic, sequence number,
+ * size or CRC; with truncate the file is cut there.
+ */
+ReadingJournal::Recovery ReadingJournal::recover(const QString &fileName, bool truncate)
+{
+    Recovery rec;
+    QFile f(fileName);
+    if (!QFile::exists(fileName)) return rec;
+    if (!f.open(truncate ? QIODevice::ReadWrite : QIODevice::ReadOnly)) return rec;
+
+    scan(f, rec, 0);
+    rec.truncatedBytes = f.size() - rec.validBytes;
+    if (truncate && rec.truncatedBytes > 0) {
+        f.resize(rec.validBytes);
+        syncFile(f);
+    }
+    return rec;
+}
+
+/**
+ * @brief Call visit for every record of the valid blocks, in order.
+ */
+bool ReadingJournal::replay(const QString &fileName, const Visitor &visit)
+{
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly)) return false;
+    Recovery rec;
+    return scan(f, rec, &visit);
+}
+
+bool ReadingJournal::scan(QFile &file, Recovery &rec, const Visitor *visit)
+{
+    const qint64 maxRecords = 1 << 20;     // a larger count is corruption, not a block
+    qint64 size = file.size();
+    qint64 pos = 0;
+    file.seek(0);
+
+    while (pos + qint64(sizeof(JournalBlockHeader)) <= size) {
+        JournalBlockHeader h;
+        if (file.read(reinterpret_cast<char*>(&h), sizeof(h)) != qint64(sizeof(h))) break;
+        if (std::memcmp(h.magic, "AJRN", 4) != 0) break;
+        if (h.seq != rec.lastSeq + 1 && rec.blocks > 0) break;
+        if (h.count == 0 || h.count > maxRecords) break;
+
+        qint64 bytes = qint64(h.count)*sizeof(AtlasReading);
+        if (pos + qint64(sizeof(h)) + bytes > size) break;
+        QByteArray payload = file.read(bytes);
+        if (payload.size() != bytes || crc32(payload.constData(), bytes) != h.crc) break;
+
+        if (visit) {
+            const AtlasReading *r = reinterpret_cast<const AtlasReading*>(payload.constData());
+            for (quint32 i = 0; i < h.count; ++i) {
+                if (!(*visit)(h.seq, r[i])) return false;
+            }
+        }
+        ++rec.blocks;
+        rec.records += h.count;
+        rec.lastSeq = h.seq;
+        pos += qint64(sizeof(h)) + bytes;
+        rec.validBytes = pos;
+    }
+    return true;
+}
+
+/**
+ * @brief CRC-32 (IEEE 802.3, as zlib), continue a running crc by passing it in.
+ */
+quint32 ReadingJournal::crc32(const char *data, qint64 size, quint32 crc)
+{
+    static const struct Table {
+        quint32 t[256];
+        Table()
+        {
+            for (quint32 i = 0; i < 256; ++i) {
+                quint32 c = i;
+                for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+        }
+    } table;
+
+    crc = ~crc;
+    for (qint64 i = 0; i < size; ++i) {
+        crc = table.t[(crc ^ quint8(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/**
+ * @brief Force the written data of file to disk (fsync), not only to the OS cache.
+ */
+bool ReadingJournal::syncFile(QFile &file)
+{
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return fsync(file.handle()) == 0;
+#endif
+}
@@ -0,0 +1,96 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef READINGJOURNAL_H
+#define READINGJOURNAL_H
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <functional>
+
+#include "atlasreading.h"
+
+/** @brief Header of one journal block, followed by count AtlasReading records. */
+struct JournalBlockHeader {
+    char    magic[4];       /**< "AJRN" */
+    quint32 seq;            /**< 1, 2, 3 ... without gaps */
+    quint32 count;          /**< records in the block */
+    quint32 crc;            /**< CRC-32 of the records */
+    };
+
+/** @brief Append-only, checksummed journal of readings ("<log>.wal").
+ *
+ * Records are collected and written as one block per group commit, followed by
+ * one fsync. A crash can only tear the last block; recover() finds the last
+ * block with a valid sequence number and CRC and cuts off everything after it.
+ * Once the log itself is on disk, checkpoint() removes the blocks written since open().
+*/
+class ReadingJournal
+{
+public:
+    /** @brief Outcome of recover(). */
+    struct Recovery {
+        quint32 blocks = 0;         /**< valid blocks */
+        qint64  records = 0;        /**< records in the valid blocks */
+        quint32 lastSeq = 0;        /**< sequence number of the last valid block */
+        qint64  validBytes = 0;     /**< size of the journal after recovery */
+        qint64  truncatedBytes = 0; /**< torn tail that was cut off */
+        };
+
+    typedef std::function<bool(quint32 seq, const AtlasReading &)> Visitor;  /**< return false to stop */
+
+    ReadingJournal();
+    ~ReadingJournal();
+
+    bool open(const QString &fileName);
+    void append(const AtlasReading &reading);
+    bool commit(bool sync = true);
+    bool checkpoint();
+    void close();
+    bool isOpen() const;
+    qint64 size() const;
+
+    static Recovery recover(const QString &fileName, bool truncate = true);
+    static bool replay(const QString &fileName, const Visitor &visit);
+    static quint32 crc32(const char *data, qint64 size, quint32 crc = 0);
+    static bool syncFile(QFile &file);
+
+private:
+    static bool scan(QFile &file, Recovery &rec, const Visitor *visit);
+
+    QFile file;
+    QByteArray payload;     /**< records of the next block */
+    quint32 count = 0;
+    quint32 seq = 0;        /**< sequence number of the last written block */
+    qint64 validBytes = 0;  /**< end of the last complete block */
+    quint32 openSeq = 0;    /**< seq and validBytes after recovery in open() */
+    qint64 openBytes = 0;
+};
+
+#endif // READINGJOURNAL_H
@@ -0,0 +1,79 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "readingsource.h"
+#include <QDateTime>
+
+ReadingSource::ReadingSource(QObject *parent) :
+    QObject(parent)
+{
+
+}
+
+StampSource::StampSource(QAtlasUSB *stamp, quint16 stampId, QObject *parent) :
+    ReadingSource(parent),
+    stamp(stamp),
+    stampId(stampId)
+{
+
+}
+
+bool StampSource::isActive() const
+{
+    return active;
+}
+
+void StampSource::start()
+{
+    if (active) return;
+    connect( stamp, SIGNAL(measRead()),
+             this, SLOT(onMeasRead()) );
+    active = true;
+}
+
+void StampSource::stop()
+{
+    if (!active) return;
+    disconnect( stamp, SIGNAL(measRead()),
+                this, SLOT(onMeasRead()) );
+    active = false;
+    emit finished(0, 0);
+}
+
+/**
+ * @brief Turn the measurement just parsed by the stamp into a reading.
+ */
+void StampSource::onMeasRead()
+{
+    AtlasReading r;
+    r.timeMs = QDateTime::currentMSecsSinceEpoch();
+    r.stampId = stampId;
+    r.channel = quint16(stamp->getChannel());
+    r.value = stamp->getCurrentValue();
+    emit readingAvailable(r);
+}
@@ -0,0 +1,83 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef READINGSOURCE_H
+#define READINGSOURCE_H
+
+#include <QObject>
+
+#include "atlasreading.h"
+#include "qatlasusb.h"
+
+/** @brief Producer of readings for the display, plot and logging pipeline.
+ *
+ * The live stamps and a replayed log are interchangeable: MainWindow
+ * only listens to readingAvailable() of its current source.
+*/
+class ReadingSource : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ReadingSource(QObject *parent = 0);
+
+    virtual bool isActive() const = 0;
+
+public slots:
+    virtual void start() = 0;
+    virtual void stop() = 0;
+
+signals:
+    void readingAvailable(const AtlasReading &reading);
+    void finished(qint64 readings, qint64 elapsedMs);
+};
+
+/** @brief Live source: the parsed measurements of one stamp. */
+class StampSource : public ReadingSource
+{
+    Q_OBJECT
+
+public:
+    explicit StampSource(QAtlasUSB *stamp, quint16 stampId = 0, QObject *parent = 0);
+
+    bool isActive() const;
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void onMeasRead();
+
+private:
+    QAtlasUSB* stamp;
+    quint16 stampId;
+    bool active = false;
+};
+
+#endif // READINGSOURCE_H
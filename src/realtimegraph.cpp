@@ -0,0 +1,247 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "realtimegraph.h"
+#include <limits>
+
+RealtimeGraph::RealtimeGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
+    QCPAbstractPlottable(keyAxis, valueAxis)
+{
+    setPen(QPen(Qt::blue));
+    setSelectedPen(QPen(QColor(80, 80, 255), 2.5));
+    setBrush(Qt::NoBrush);
+}
+
+const RingSeries &RealtimeGraph::data() const
+{
+    return series;
+}
+
+/**
+ * @brief Number of points kept, rounded up to a power of two; the newest points are kept.
+ */
+void RealtimeGraph::setCapacity(int value)
+{
+    series.setCapacity(value);
+}
+
+void RealtimeGraph::addData(double key, double value)
+{
+    series.append(key, value);
+}
+
+void RealtimeGraph::addData(const QVector<double> &keys, const QVector<double> &values)
+{
+    int n = qMin(keys.size(), values.size());
+    for (int i = 0; i < n; ++i) series.append(keys.at(i), values.at(i));
+}
+
+void RealtimeGraph::removeDataBefore(double key)
+{
+    series.removeBefore(key);
+}
+
+void RealtimeGraph::clearData()
+{
+    series.clear();
+}
+
+/**
+ * @brief Pixel distance of pos to the line, -1 if it is out of reach.
+ *
+ * Only the segments within the selection tolerance (in key direction) are tested.
+ */
+double RealtimeGraph::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const
+{
+    Q_UNUSED(details);
+    if ((onlySelectable && !mSelectable) || series.isEmpty()) return -1;
+    if (!mKeyAxis || !mValueAxis) return -1;
+    if (!mKeyAxis.data()->axisRect()->rect().contains(pos.toPoint())) return -1;
+
+    QCPAxis *keyAxis = mKeyAxis.data();
+    double tolerance = mParentPlot->selectionTolerance();
+    double keyPixel = keyAxis->orientation() == Qt::Horizontal ? pos.x() : pos.y();
+    double k0 = keyAxis->pixelToCoord(keyPixel - tolerance);
+    double k1 = keyAxis->pixelToCoord(keyPixel + tolerance);
+    if (k0 > k1) qSwap(k0, k1);
+
+    int begin = qMax(series.lowerBound(k0) - 1, 0);
+    int end = qMin(series.lowerBound(k1) + 1, series.size());
+    if (end - begin == 1) {
+        QPointF d = pointAt(begin) - pos;
+        return qSqrt(d.x()*d.x() + d.y()*d.y());
+    }
+    double minDistSqr = std::numeric_limits<double>::max();
+    for (int i = begin; i + 1 < end; ++i) {
+        minDistSqr = qMin(minDistSqr, distSqrToLine(pointAt(i), pointAt(i + 1), pos));
+    }
+    return qSqrt(minDistSqr);
+}
+
+void RealtimeGraph::draw(QCPPainter *painter)
+{
+    if (!mKeyAxis || !mValueAxis || series.isEmpty()) return;
+    if (mainPen().style() == Qt::NoPen || mainPen().color().alpha() == 0) return;
+
+    // a scrolling layer only redraws a strip, see QCPLayer::setScrollAxis:
+    getLinePoints(lineBuffer, painter->hasClipping() ? painter->clipBoundingRect() : QRectF());
+    if (lineBuffer.size() < 2) return;
+
+    applyDefaultAntialiasingHint(painter);
+    painter->setPen(mainPen());
+    painter->setBrush(Qt::NoBrush);
+    painter->drawPolyline(lineBuffer.constData(), lineBuffer.size());
+}
+
+void RealtimeGraph::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
+{
+    applyDefaultAntialiasingHint(painter);
+    painter->setPen(mPen);
+    painter->drawLine(QLineF(rect.left(), rect.top()+rect.height()/2.0, rect.right()+5, rect.top()+rect.height()/2.0));
+}
+
+QCPRange RealtimeGraph::getKeyRange(bool &foundRange, SignDomain inSignDomain) const
+{
+    QCPRange range;
+    foundRange = false;
+    if (inSignDomain == sdBoth) {
+        foundRange = !series.isEmpty();
+        if (foundRange) range = QCPRange(series.key(0), series.key(series.size() - 1));
+        return range;
+    }
+    for (int i = 0; i < series.size(); ++i) {
+        double k = series.key(i);
+        if ((inSignDomain == sdNegative && k >= 0) || (inSignDomain == sdPositive && k <= 0)) continue;
+        if (!foundRange) {
+            range.lower = range.upper = k;
+            foundRange = true;
+        }
+        range.upper = k;    // keys are in increasing order
+    }
+    return range;
+}
+
+QCPRange RealtimeGraph::getValueRange(bool &foundRange, SignDomain inSignDomain) const
+{
+    QCPRange range;
+    foundRange = false;
+    if (inSignDomain == sdBoth) {
+        // O(1), rescaleValueAxis() runs on every frame
+        foundRange = series.valueBounds(range.lower, range.upper);
+        return range;
+    }
+    for (int i = 0; i < series.size(); ++i) {
+        double v = series.value(i);
+        if ((inSignDomain == sdNegative && v >= 0) || (inSignDomain == sdPositive && v <= 0)) continue;
+        if (!foundRange) {
+            range.lower = range.upper = v;
+            foundRange = true;
+        }
+        range.lower = qMin(range.lower, v);
+        range.upper = qMax(range.upper, v);
+    }
+    return range;
+}
+
+/**
+ * @brief Points within the key axis range, plus one on each side so the line reaches the border.
+ */
+void RealtimeGraph::visibleRange(int &begin, int &end) const
+{
+    QCPRange range = mKeyAxis.data()->range();
+    begin = qMax(series.lowerBound(range.lower) - 1, 0);
+    end = qMin(series.lowerBound(range.upper) + 1, series.size());
+}
+
+QPointF RealtimeGraph::pointAt(int i) const
+{
+    return coordsToPixels(series.key(i), series.value(i));
+}
+
+/**
+ * @brief Pixel coordinates of the visible line.
+ *
+ * With more points than pixel columns, each column is reduced to its
+ * minimum and maximum (in data order), which keeps the envelope of the line.
+ * A valid clip limits the points to the pixel columns it covers (plus two
+ * columns on each side); the reduction is still chosen for the whole line,
+ * so a clipped redraw matches the pixels of a full one.
+ */
+void RealtimeGraph::getLinePoints(QVector<QPointF> &points, const QRectF &clip) const
+{
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    int begin, end;
+    visibleRange(begin, end);
+    points.resize(0);
+    if (end - begin < 2) return;
+
+    int pixels = qMax(1, int(qAbs(keyAxis->coordToPixel(series.key(end - 1)) - keyAxis->coordToPixel(series.key(begin)))));
+    bool dense = end - begin > 2*pixels;
+    if (clip.isValid()) {
+        bool horizontal = keyAxis->orientation() == Qt::Horizontal;
+        double k0 = keyAxis->pixelToCoord((horizontal ? clip.left() : clip.top()) - 2);
+        double k1 = keyAxis->pixelToCoord((horizontal ? clip.right() : clip.bottom()) + 2);
+        if (k0 > k1) qSwap(k0, k1);
+        begin = qMax(begin, series.lowerBound(k0) - 1);
+        end = qMin(end, series.lowerBound(k1) + 1);
+        if (end - begin < 2) return;
+    }
+    if (!dense) {
+        for (int i = begin; i < end; ++i) points.append(pointAt(i));
+        return;
+    }
+
+    bool horizontal = keyAxis->orientation() == Qt::Horizontal;
+    int column = int(keyAxis->coordToPixel(series.key(begin)));
+    double minValue = series.value(begin);
+    double maxValue = minValue;
+    bool minFirst = true;
+    for (int i = begin; i <= end; ++i) {
+        int c = i < end ? int(keyAxis->coordToPixel(series.key(i))) : std::numeric_limits<int>::min();
+        if (c != column) {
+            double p0 = valueAxis->coordToPixel(minFirst ? minValue : maxValue);
+            double p1 = valueAxis->coordToPixel(minFirst ? maxValue : minValue);
+            points.append(horizontal ? QPointF(column, p0) : QPointF(p0, column));
+            if (p1 != p0) points.append(horizontal ? QPointF(column, p1) : QPointF(p1, column));
+            if (i == end) break;
+            column = c;
+            minValue = maxValue = series.value(i);
+            minFirst = true;
+            continue;
+        }
+        double v = series.value(i);
+        if (v < minValue) {
+            minValue = v;
+            minFirst = false;
+        } else if (v > maxValue) {
+            maxValue = v;
+            minFirst = true;
+        }
+    }
+}
@@ -0,0 +1,71 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef REALTIMEGRAPH_H
+#define REALTIMEGRAPH_H
+
+#include "thirdparty/qcustomplot.h"
+#include "ringseries.h"
+
+/** @brief Line plottable for a scrolling realtime window, backed by a RingSeries.
+ *
+ * Unlike QCPGraph (QMap based), appending and expiring points never
+ * allocates; draw() iterates the visible part of the ring directly and
+ * reduces it to min/max per pixel column when it is denser than the screen.
+*/
+class RealtimeGraph : public QCPAbstractPlottable
+{
+    Q_OBJECT
+
+public:
+    RealtimeGraph(QCPAxis *keyAxis, QCPAxis *valueAxis);
+
+    const RingSeries &data() const;
+    void setCapacity(int value);
+    void addData(double key, double value);
+    void addData(const QVector<double> &keys, const QVector<double> &values);
+    void removeDataBefore(double key);
+
+    virtual void clearData();
+    virtual double selectTest(const QPointF &pos, bool onlySelectable, QVariant *details=0) const;
+
+protected:
+    virtual void draw(QCPPainter *painter);
+    virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const;
+    virtual QCPRange getKeyRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const;
+    virtual QCPRange getValueRange(bool &foundRange, SignDomain inSignDomain=sdBoth) const;
+
+    void visibleRange(int &begin, int &end) const;
+    QPointF pointAt(int i) const;
+    void getLinePoints(QVector<QPointF> &points, const QRectF &clip = QRectF()) const;
+
+    RingSeries series;
+    mutable QVector<QPointF> lineBuffer;    /**< reused by draw(), no allocation per frame */
+};
+
+#endif // REALTIMEGRAPH_H
@@ -0,0 +1,167 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "replaysource.h"
+
+ReplaySource::ReplaySource(QObject *parent) :
+    ReadingSource(parent)
+{
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    timer->setTimerType(Qt::PreciseTimer);
+    connect( timer, SIGNAL(timeout()),
+             this, SLOT(emitDue()) );
+}
+
+/**
+ * @brief Select the log to replay.
+ *
+ * @return false if there is no such log
+ */
+bool ReplaySource::open(const QString &fileName)
+{
+    stop();
+    store = QSharedPointer<LogStore>(new LogStore(fileName));
+    if (!store->isValid()) {
+        store.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ReplaySource::isActive() const
+{
+    return active;
+}
+
+void ReplaySource::start()
+{
+    if (active || !store) return;
+
+    cursor = QSharedPointer<LogCursor>(new LogCursor(*store, fromMs, toMs));
+    chunk.clear();
+    next = 0;
+    readings = 0;
+    if (!fill()) {
+        cursor.clear();
+        emit finished(0, 0);
+        return;
+    }
+    firstMs = chunk.first().timeMs;
+    active = true;
+    clock.start();
+    timer->start(0);
+}
+
+void ReplaySource::stop()
+{
+    if (!active) return;
+    timer->stop();
+    active = false;
+    cursor.clear();
+    emit finished(readings, clock.elapsed());
+}
+
+/**
+ * @brief Emit all readings that are due, then wait for the next one.
+ *
+ * At most maxBatch readings per call, so the GUI stays responsive at max speed.
+ */
+void ReplaySource::emitDue()
+{
+    if (!active) return;
+    qint64 now = clock.elapsed();
+
+    for (int n = 0; n < maxBatch; ++n) {
+        if (next >= chunk.size() && !fill()) {
+            stop();
+            return;
+        }
+        const AtlasReading &r = chunk.at(next);
+        if (speed > 0) {
+            qint64 due = qint64((r.timeMs - firstMs)/speed);
+            if (due > now) {
+                timer->start(int(qMin(due - now, qint64(1000))));
+                return;
+            }
+        }
+        ++next;
+        ++readings;
+        emit readingAvailable(r);
+        if (!active) return;        // stopped by a receiver
+    }
+    timer->start(0);
+}
+
+/**
+ * @brief Read the next chunk of the log.
+ *
+ * The cursor continues in the open file where the last chunk ended,
+ * the log is not searched again for each chunk.
+ */
+bool ReplaySource::fill()
+{
+    chunk.clear();
+    next = 0;
+    AtlasReading r;
+    while (chunk.size() < chunkSize && cursor->next(r)) chunk.append(r);
+    return !chunk.isEmpty();
+}
+
+// Getters and Setters
+double ReplaySource::getSpeed() const
+{
+    return speed;
+}
+
+/**
+ * @brief Replay speed: 1 real time, N N times faster, 0 as fast as possible.
+ */
+void ReplaySource::setSpeed(double value)
+{
+    speed = qMax(0.0, value);
+}
+
+/**
+ * @brief Replay only readings with fromMs <= time <= toMs.
+ */
+void ReplaySource::setRange(qint64 fromMs, qint64 toMs)
+{
+    this->fromMs = fromMs;
+    this->toMs = toMs;
+}
+
+qint64 ReplaySource::getReadings() const
+{
+    return readings;
+}
+
+QString ReplaySource::getFileName() const
+{
+    return store ? store->getFileName() : QString();
+}
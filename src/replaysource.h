@@ -0,0 +1,95 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef REPLAYSOURCE_H
+#define REPLAYSOURCE_H
+
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QSharedPointer>
+#include <limits>
+
+#include "readingsource.h"
+#include "logstore.h"
+
+/** @brief Replays a recorded log (CSV, binary or rotated) as a reading source.
+ *
+ * Readings keep their logged times and are emitted with their original
+ * spacing divided by the speed; speed 0 emits as fast as possible, which
+ * makes the replay a throughput benchmark of everything downstream.
+ * The log is read in chunks through a LogCursor that keeps its file position,
+ * memory does not grow with the log and each chunk continues where the last one ended.
+*/
+class ReplaySource : public ReadingSource
+{
+    Q_OBJECT
+
+public:
+    explicit ReplaySource(QObject *parent = 0);
+
+    bool open(const QString &fileName);
+    bool isActive() const;
+
+// getters
+    double getSpeed() const;
+    qint64 getReadings() const;
+    QString getFileName() const;
+
+// setters
+    void setSpeed(double value);
+    void setRange(qint64 fromMs, qint64 toMs);
+
+public slots:
+    void start();
+    void stop();
+
+private slots:
+    void emitDue();
+
+private:
+    bool fill();
+
+    QSharedPointer<LogStore> store;
+    QSharedPointer<LogCursor> cursor;   /**< position in the log while active */
+    QTimer* timer;
+    QElapsedTimer clock;        /**< wall time since start() */
+
+    QVector<AtlasReading> chunk;
+    int next = 0;
+    qint64 firstMs = 0;         /**< log time of the first reading, replayed at start() */
+    qint64 fromMs = std::numeric_limits<qint64>::min();
+    qint64 toMs = std::numeric_limits<qint64>::max();
+    qint64 readings = 0;
+    bool active = false;
+
+    double speed = 1.0;         /**< 1: real time, N: N times faster, 0: as fast as possible */
+    int chunkSize = 4096;       /**< readings read from the log at once */
+    int maxBatch = 1024;        /**< readings emitted before the event loop runs again */
+};
+
+#endif // REPLAYSOURCE_H
@@ -0,0 +1,187 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "ringseries.h"
+
+#include <QtNumeric>
+
+RingSeries::RingSeries(int capacity)
+{
+    mask = 0;
+    setCapacity(capacity);
+}
+
+/**
+ * @brief Resize the buffer (rounded up to a power of two), keeping the newest points.
+ *
+ * The only operation that allocates.
+ */
+void RingSeries::setCapacity(int value)
+{
+    int cap = 2;
+    while (cap < value && cap < (1 << 30)) cap <<= 1;
+    if (cap == mask + 1) return;
+
+    int keep = qMin(count, cap);
+    QVector<double> k(cap);
+    QVector<double> v(cap);
+    for (int i = 0; i < keep; ++i) {
+        k[i] = key(count - keep + i);
+        v[i] = this->value(count - keep + i);
+    }
+    keys.swap(k);
+    values.swap(v);
+    mask = cap - 1;
+    first = 0;
+    count = keep;
+
+    // rebuild the extreme value queues for the kept points
+    head = 0;
+    minQueue.seq.resize(cap);
+    maxQueue.seq.resize(cap);
+    minQueue.first = minQueue.count = 0;
+    maxQueue.first = maxQueue.count = 0;
+    for (int i = 0; i < count; ++i) {
+        if (qIsNaN(this->value(i))) continue;
+        push(minQueue, i, this->value(i), true);
+        push(maxQueue, i, this->value(i), false);
+    }
+}
+
+int RingSeries::capacity() const
+{
+    return mask + 1;
+}
+
+int RingSeries::size() const
+{
+    return count;
+}
+
+bool RingSeries::isEmpty() const
+{
+    return count == 0;
+}
+
+/**
+ * @brief Append a point; keys are expected in increasing order.
+ */
+void RingSeries::append(double key, double value)
+{
+    if (count > mask) dropOldest();     // full: the oldest point is overwritten
+    int slot = (first + count) & mask;
+    keys.data()[slot] = key;
+    values.data()[slot] = value;
+    ++count;
+    if (qIsNaN(value)) return;
+    push(minQueue, head + count - 1, value, true);
+    push(maxQueue, head + count - 1, value, false);
+}
+
+/**
+ * @brief Drop the points with a key smaller than key, oldest first.
+ */
+void RingSeries::removeBefore(double key)
+{
+    while (count > 0 && this->key(0) < key) {
+        dropOldest();
+    }
+}
+
+void RingSeries::clear()
+{
+    first = 0;
+    count = 0;
+    head = 0;
+    minQueue.first = minQueue.count = 0;
+    maxQueue.first = maxQueue.count = 0;
+}
+
+/**
+ * @brief Index of the first point with a key >= key, size() if there is none.
+ */
+int RingSeries::lowerBound(double key) const
+{
+    int lo = 0;
+    int hi = count;
+    while (lo < hi) {
+        int mid = (lo + hi)/2;
+        if (this->key(mid) < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/**
+ * @brief Smallest and largest value of the points, ignoring NaN.
+ * @return false if there is no such point.
+ */
+bool RingSeries::valueBounds(double &lower, double &upper) const
+{
+    if (minQueue.count == 0) return false;
+    lower = valueOf(minQueue.seq.at(minQueue.first));
+    upper = valueOf(maxQueue.seq.at(maxQueue.first));
+    return true;
+}
+
+/**
+ * @brief Queue the newest point, dropping the queued points it supersedes.
+ *
+ * A point older than a smaller (keepSmaller) or larger newer one can no
+ * longer be the extreme, since it is removed first.
+ */
+void RingSeries::push(MonotonicQueue &queue, qint64 seq, double value, bool keepSmaller)
+{
+    while (queue.count > 0) {
+        double last = valueOf(queue.seq.at((queue.first + queue.count - 1) & mask));
+        if (keepSmaller ? last < value : last > value) break;
+        --queue.count;
+    }
+    queue.seq[(queue.first + queue.count) & mask] = seq;
+    ++queue.count;
+}
+
+/**
+ * @brief Dequeue the points that are no longer in the buffer.
+ */
+void RingSeries::expire(MonotonicQueue &queue)
+{
+    while (queue.count > 0 && queue.seq.at(queue.first) < head) {
+        queue.first = (queue.first + 1) & mask;
+        --queue.count;
+    }
+}
+
+void RingSeries::dropOldest()
+{
+    first = (first + 1) & mask;
+    --count;
+    ++head;
+    expire(minQueue);
+    expire(maxQueue);
+}
@@ -0,0 +1,85 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef RINGSERIES_H
+#define RINGSERIES_H
+
+#include <QVector>
+
+/** @brief Fixed capacity ring buffer of (key, value) points in key order.
+ *
+ * For scrolling realtime plots: append() and removeBefore() are O(1) and
+ * never allocate; when full, append() overwrites the oldest point.
+ * Index 0 is the oldest point.
+ *
+ * The minimum and maximum value are kept in monotonic queues, so
+ * valueBounds() is O(1) too (append stays amortized O(1)).
+*/
+class RingSeries
+{
+public:
+    explicit RingSeries(int capacity = 1024);
+
+    void setCapacity(int value);
+    int capacity() const;
+    int size() const;
+    bool isEmpty() const;
+
+    void append(double key, double value);
+    void removeBefore(double key);
+    void clear();
+    int lowerBound(double key) const;
+    bool valueBounds(double &lower, double &upper) const;
+
+    double key(int i) const { return keys.constData()[(first + i) & mask]; }
+    double value(int i) const { return values.constData()[(first + i) & mask]; }
+
+private:
+    /** @brief Sequence numbers of the points that can still become the extreme value. */
+    struct MonotonicQueue {
+        QVector<qint64> seq;    /**< ring of capacity slots, oldest first */
+        int first = 0;
+        int count = 0;
+        };
+
+    QVector<double> keys;
+    QVector<double> values;
+    int mask;               /**< capacity - 1, capacity is a power of two */
+    int first = 0;          /**< slot of the oldest point */
+    int count = 0;
+    qint64 head = 0;        /**< sequence number of the oldest point */
+    MonotonicQueue minQueue;
+    MonotonicQueue maxQueue;
+
+    double valueOf(qint64 seq) const { return values.constData()[(first + int(seq - head)) & mask]; }
+    void push(MonotonicQueue &queue, qint64 seq, double value, bool keepSmaller);
+    void expire(MonotonicQueue &queue);
+    void dropOldest();
+};
+
+#endif // RINGSERIES_H
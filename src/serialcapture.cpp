@@ -0,0 +1,247 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "serialcapture.h"
+#include <QDateTime>
+#include <QtDebug>
+#include <cstring>
+
+static_assert(sizeof(CaptureHeader) == 16, "capture header must be 16 bytes");
+static_assert(sizeof(CaptureChunkHeader) == 8, "chunk header must be 8 bytes");
+
+SerialCapture::SerialCapture()
+{
+
+}
+
+SerialCapture::~SerialCapture()
+{
+    close();
+}
+
+/**
+ * @brief Start a new capture file.
+ */
+bool SerialCapture::open(const QString &fileName)
+{
+    close();
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qDebug() << "SerialCapture: cannot open" << fileName << file.errorString();
+        return false;
+    }
+
+    CaptureHeader h;
+    std::memcpy(h.magic, "ATLC", 4);
+    h.version = 1;
+    h.reserved = 0;
+    h.startMs = QDateTime::currentMSecsSinceEpoch();
+    file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+
+    clock.start();
+    lastUs = 0;
+    chunks = 0;
+    return true;
+}
+
+/**
+ * @brief Append one chunk as returned by readAll(), stamped with the monotonic clock.
+ */
+void SerialCapture::record(const QByteArray &chunk)
+{
+    if (!file.isOpen() || chunk.isEmpty()) return;
+
+    qint64 nowUs = clock.nsecsElapsed()/1000;
+    CaptureChunkHeader h;
+    h.deltaUs = quint32(qMin(nowUs - lastUs, qint64(0xffffffff)));
+    h.size = quint32(chunk.size());
+    lastUs = nowUs;
+
+    file.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    file.write(chunk);
+    ++chunks;
+}
+
+void SerialCapture::close()
+{
+    if (file.isOpen()) file.close();
+}
+
+bool SerialCapture::isOpen() const
+{
+    return file.isOpen();
+}
+
+qint64 SerialCapture::getChunks() const
+{
+    return chunks;
+}
+
+CaptureReplayDevice::CaptureReplayDevice(QObject *parent) :
+    QIODevice(parent)
+{
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    timer->setTimerType(Qt::PreciseTimer);
+    connect( timer, SIGNAL(timeout()),
+             this, SLOT(emitDue()) );
+}
+
+/**
+ * @brief Stops a running replay without emitting finished().
+ *
+ * The receivers (the parent window) may already be half destroyed here.
+ */
+CaptureReplayDevice::~CaptureReplayDevice()
+{
+    blockSignals(true);
+    timer->stop();
+    file.close();
+    if (isOpen()) QIODevice::close();
+}
+
+/**
+ * @brief Open a capture file and start delivering its chunks.
+ */
+bool CaptureReplayDevice::openCapture(const QString &fileName)
+{
+    close();
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+
+    CaptureHeader h;
+    if (file.read(reinterpret_cast<char*>(&h), sizeof(h)) != qint64(sizeof(h))
+            || std::memcmp(h.magic, "ATLC", 4) != 0 || h.version != 1) {
+        file.close();
+        return false;
+    }
+
+    chunk.clear();
+    chunkPos = 0;
+    hasNext = false;
+    dueUs = 0;
+    chunks = 0;
+    bytes = 0;
+    // unbuffered: readAll() returns exactly the data of the current chunk
+    QIODevice::open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    clock.start();
+    timer->start(0);
+    return true;
+}
+
+void CaptureReplayDevice::close()
+{
+    if (!isOpen()) return;
+    timer->stop();
+    file.close();
+    QIODevice::close();
+    emit finished(chunks, bytes, clock.elapsed());
+}
+
+bool CaptureReplayDevice::isSequential() const
+{
+    return true;
+}
+
+qint64 CaptureReplayDevice::bytesAvailable() const
+{
+    return chunk.size() - chunkPos + QIODevice::bytesAvailable();
+}
+
+/**
+ * @brief Deliver the chunks that are due, one readyRead() per chunk.
+ */
+void CaptureReplayDevice::emitDue()
+{
+    for (int n = 0; n < maxBatch && isOpen(); ++n) {
+        if (!hasNext && !readChunk()) {
+            close();
+            return;
+        }
+        if (speed > 0) {
+            qint64 due = qint64(dueUs/speed);
+            qint64 now = clock.nsecsElapsed()/1000;
+            if (due > now) {
+                timer->start(int((due - now + 999)/1000));
+                return;
+            }
+        }
+        // data not read by the receiver stays in front of the new chunk
+        chunk = chunk.mid(chunkPos) + next;
+        chunkPos = 0;
+        hasNext = false;
+        ++chunks;
+        bytes += next.size();
+        emit readyRead();
+    }
+    if (isOpen()) timer->start(0);
+}
+
+bool CaptureReplayDevice::readChunk()
+{
+    CaptureChunkHeader h;
+    if (file.read(reinterpret_cast<char*>(&h), sizeof(h)) != qint64(sizeof(h))) return false;
+    next = file.read(h.size);
+    if (next.size() != int(h.size)) return false;     // torn end of the capture
+    dueUs += h.deltaUs;
+    hasNext = true;
+    return true;
+}
+
+qint64 CaptureReplayDevice::readData(char *data, qint64 maxSize)
+{
+    qint64 n = qMin(maxSize, qint64(chunk.size() - chunkPos));
+    std::memcpy(data, chunk.constData() + chunkPos, size_t(n));
+    chunkPos += int(n);
+    return n;
+}
+
+qint64 CaptureReplayDevice::writeData(const char *data, qint64 maxSize)
+{
+    Q_UNUSED(data);
+    return maxSize;
+}
+
+// Getters and Setters
+double CaptureReplayDevice::getSpeed() const
+{
+    return speed;
+}
+
+/**
+ * @brief Replay speed: 1 original timing, N N times faster, 0 as fast as possible.
+ */
+void CaptureReplayDevice::setSpeed(double value)
+{
+    speed = qMax(0.0, value);
+}
+
+qint64 CaptureReplayDevice::getChunks() const
+{
+    return chunks;
+}
@@ -0,0 +1,138 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef SERIALCAPTURE_H
+#define SERIALCAPTURE_H
+
+#include <QIODevice>
+#include <QFile>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QByteArray>
+
+/*
+Capture file layout (little endian):
+
+    CaptureHeader           16 bytes
+    CaptureChunkHeader      8 bytes, then size bytes of the chunk
+    CaptureChunkHeader      ...
+
+One chunk per serial readAll(), in the order received.
+*/
+
+/** @brief File header of a serial capture. */
+struct CaptureHeader {
+    char    magic[4];       /**< "ATLC" */
+    quint16 version;        /**< 1 */
+    quint16 reserved;
+    qint64  startMs;        /**< wall clock at the start of the capture, ms since epoch */
+    };
+
+/** @brief Header of one captured chunk. */
+struct CaptureChunkHeader {
+    quint32 deltaUs;        /**< monotonic time since the previous chunk (or the start), us */
+    quint32 size;           /**< bytes of the chunk */
+    };
+
+/** @brief Records the raw serial chunks with their monotonic arrival times. */
+class SerialCapture
+{
+public:
+    SerialCapture();
+    ~SerialCapture();
+
+    bool open(const QString &fileName);
+    void record(const QByteArray &chunk);
+    void close();
+    bool isOpen() const;
+    qint64 getChunks() const;
+
+private:
+    QFile file;
+    QElapsedTimer clock;
+    qint64 lastUs = 0;
+    qint64 chunks = 0;
+};
+
+/** @brief Read-only transport that plays a capture back chunk by chunk.
+ *
+ * Every readyRead() makes exactly one captured chunk available, at its
+ * original time divided by the speed (0: as fast as possible), so the
+ * ingest path sees the same chunk boundaries as with the real port.
+ * Written commands are discarded.
+*/
+class CaptureReplayDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit CaptureReplayDevice(QObject *parent = 0);
+    ~CaptureReplayDevice();
+
+    bool openCapture(const QString &fileName);
+    void close();
+    bool isSequential() const;
+    qint64 bytesAvailable() const;
+
+// getters
+    double getSpeed() const;
+    qint64 getChunks() const;
+
+// setters
+    void setSpeed(double value);
+
+signals:
+    void finished(qint64 chunks, qint64 bytes, qint64 elapsedMs);
+
+protected:
+    qint64 readData(char *data, qint64 maxSize);
+    qint64 writeData(const char *data, qint64 maxSize);
+
+private slots:
+    void emitDue();
+
+private:
+    bool readChunk();
+
+    QFile file;
+    QTimer* timer;
+    QElapsedTimer clock;        /**< wall time since openCapture() */
+
+    QByteArray chunk;           /**< data made available by the last readyRead() */
+    int chunkPos = 0;
+    QByteArray next;            /**< next chunk, not due yet */
+    bool hasNext = false;
+    qint64 dueUs = 0;           /**< capture time of next */
+
+    qint64 chunks = 0;
+    qint64 bytes = 0;
+    double speed = 1.0;         /**< 1: original timing, N: N times faster, 0: as fast as possible */
+    int maxBatch = 256;         /**< chunks delivered before the event loop runs again */
+};
+
+#endif // SERIALCAPTURE_H
@@ -0,0 +1,227 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "sleepscheduler.h"
+#include <QtDebug>
+
+SleepScheduler::SleepScheduler(QAtlasUSB *stamp, QObject *parent) :
+    QObject(parent),
+    stamp(stamp)
+{
+    cycleTimer = new QTimer(this);
+    cycleTimer->setSingleShot(true);
+    connect(cycleTimer, SIGNAL(timeout()),
+            this, SLOT(onCycleTimeout()));
+}
+
+SleepScheduler::~SleepScheduler()
+{
+
+}
+
+/**
+ * @brief Start duty cycling: the stamp is woken and the first cycle begins.
+ *
+ * Readings are requested with "R", the stamp is put to sleep with "SLEEP"
+ * and woken again ahead of the next cycle, so that the wake-up latency
+ * does not shift the moment of the first reading.
+ */
+void SleepScheduler::start()
+{
+    if (isActive()) return;
+
+    awakeMs = 0;
+    asleepMs = 0;
+    stateClock.start();
+
+    emit cmdAvailable(stamp->wake());
+    wakeClock.start();
+    setState(csWaking);
+    cycleTimer->start(policy.wakeLatencyMs + qMax(measuredWakeMs, qint64(0)));
+}
+
+/**
+ * @brief Stop duty cycling and leave the stamp awake for manual commands.
+ */
+void SleepScheduler::stop()
+{
+    if (!isActive()) return;
+
+    cycleTimer->stop();
+    if (state == csAsleep) emit cmdAvailable(stamp->wake());
+    setState(csIdle);
+}
+
+/**
+ * @brief Handle the "*WA" response of the stamp.
+ *
+ * The time between the wake command and "*WA" is the wake-up latency;
+ * the settling time of the policy starts from here.
+ */
+void SleepScheduler::stampWoke()
+{
+    if (state != csWaking) return;
+
+    qint64 latency = wakeClock.elapsed();
+    // smooth the measurement, a single slow USB transfer must not shift all cycles
+    measuredWakeMs = (measuredWakeMs < 0) ? latency : (3*measuredWakeMs + latency)/4;
+    cycleTimer->start(policy.wakeLatencyMs);
+}
+
+/**
+ * @brief Count a valid reading of the stamp (connected to QAtlasUSB::measRead).
+ */
+void SleepScheduler::sampleRead()
+{
+    if (state != csSampling) return;
+
+    ++samplesTaken;
+    if (samplesTaken >= policy.samples) goToSleep();
+}
+
+void SleepScheduler::onCycleTimeout()
+{
+    switch (state) {
+    case csWaking:
+        cycleClock.start();
+        samplesTaken = 0;
+        samplesRequested = 0;
+        setState(csSampling);
+        requestSample();
+        break;
+    case csSampling:
+        // give up after twice the number of requests, a lost reading must not keep the stamp awake
+        if (samplesRequested >= 2*policy.samples) goToSleep();
+        else requestSample();
+        break;
+    case csAsleep:
+        emit cmdAvailable(stamp->wake());
+        wakeClock.start();
+        setState(csWaking);
+        cycleTimer->start(policy.wakeLatencyMs + qMax(measuredWakeMs, qint64(0)));
+        break;
+    case csIdle:
+        break;
+    }
+}
+
+void SleepScheduler::requestSample()
+{
+    ++samplesRequested;
+    emit cmdAvailable(stamp->readpHORP());
+    cycleTimer->start(policy.sampleIntervalMs);
+}
+
+void SleepScheduler::goToSleep()
+{
+    cycleTimer->stop();
+    emit cmdAvailable(stamp->sleep());
+    setState(csAsleep);
+
+    // wake up ahead of the next cycle by the expected wake-up latency
+    qint64 lead = policy.wakeLatencyMs + qMax(measuredWakeMs, qint64(0));
+    qint64 next = policy.periodMs - cycleClock.elapsed() - lead;
+    cycleTimer->start(int(qMax(next, qint64(0))));
+}
+
+void SleepScheduler::setState(CycleState newState)
+{
+    qint64 elapsed = stateClock.restart();
+    if (state == csAsleep) asleepMs += elapsed;
+    else if (state != csIdle) awakeMs += elapsed;
+
+    state = newState;
+    emit stateChanged(state);
+}
+
+// Getters and Setters
+SleepScheduler::DutyCyclePolicy SleepScheduler::getPolicy() const
+{
+    return policy;
+}
+
+/**
+ * @brief Policy of the next start(), read from the [Stamp1] group of the ini file.
+ *
+ * Values are clamped: at least one sample, sample interval >= conversion time,
+ * a period long enough for wake-up and all samples.
+ */
+void SleepScheduler::setPolicy(const DutyCyclePolicy &value)
+{
+    policy = value;
+    policy.wakeLatencyMs = qMax(0, policy.wakeLatencyMs);
+    policy.samples = qMax(1, policy.samples);
+    policy.sampleIntervalMs = qMax(1000, policy.sampleIntervalMs);
+    policy.periodMs = qMax(policy.periodMs,
+                           policy.wakeLatencyMs + policy.samples*policy.sampleIntervalMs);
+}
+
+SleepScheduler::CycleState SleepScheduler::getState() const
+{
+    return state;
+}
+
+bool SleepScheduler::isActive() const
+{
+    return state != csIdle;
+}
+
+/**
+ * @brief Total time the stamp was awake since start(), in ms.
+ */
+qint64 SleepScheduler::getAwakeMs() const
+{
+    if (state == csWaking || state == csSampling) return awakeMs + stateClock.elapsed();
+    return awakeMs;
+}
+
+/**
+ * @brief Total time the stamp was asleep since start(), in ms.
+ */
+qint64 SleepScheduler::getAsleepMs() const
+{
+    if (state == csAsleep) return asleepMs + stateClock.elapsed();
+    return asleepMs;
+}
+
+/**
+ * @brief Fraction of time awake: 0 (always asleep) .. 1 (always awake).
+ */
+double SleepScheduler::getDutyRatio() const
+{
+    qint64 total = getAwakeMs() + getAsleepMs();
+    return (total > 0) ? double(getAwakeMs())/total : 0.0;
+}
+
+/**
+ * @brief Measured time between wake command and "*WA", -1 if not measured yet.
+ */
+qint64 SleepScheduler::getMeasuredWakeMs() const
+{
+    return measuredWakeMs;
+}
@@ -0,0 +1,108 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef SLEEPSCHEDULER_H
+#define SLEEPSCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include "qatlasusb.h"
+
+class SleepScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SleepScheduler(QAtlasUSB *stamp, QObject *parent = 0);
+    ~SleepScheduler();
+
+/** @brief struct containing the duty-cycle policy of one EZO stamp.
+ *
+ * One cycle is: wake, settle, read N samples, sleep.
+ * The wake command is sent wakeLatency ms ahead of the cycle start,
+ * so the first reading is taken on time.
+*/
+struct DutyCyclePolicy {
+    int periodMs = 300000;        /**< time between the first readings of two cycles */
+    int wakeLatencyMs = 1500;     /**< time after wake-up before a reading is valid */
+    int samples = 3;              /**< number of readings per cycle */
+    int sampleIntervalMs = 1000;  /**< time between readings ( >= conversion time) */
+    };
+
+    enum CycleState { csIdle, csWaking, csSampling, csAsleep };
+
+// getters
+    DutyCyclePolicy getPolicy() const;
+    CycleState getState() const;
+    bool isActive() const;
+    qint64 getAwakeMs() const;
+    qint64 getAsleepMs() const;
+    double getDutyRatio() const;
+    qint64 getMeasuredWakeMs() const;
+
+// setters
+    void setPolicy(const DutyCyclePolicy &value);
+
+public slots:
+    void start();
+    void stop();
+
+    void stampWoke();
+    void sampleRead();
+
+signals:
+    void cmdAvailable(QByteArray newCommand);
+    void stateChanged(int state);
+
+private slots:
+    void onCycleTimeout();
+
+private:
+    void setState(CycleState newState);
+    void requestSample();
+    void goToSleep();
+
+    QAtlasUSB* stamp;
+    DutyCyclePolicy policy;
+    CycleState state = csIdle;
+
+    QTimer* cycleTimer;
+    QElapsedTimer stateClock;   /**< time spent in the current state */
+    QElapsedTimer cycleClock;   /**< time since the first reading of the cycle */
+    QElapsedTimer wakeClock;    /**< time since the wake command was sent */
+
+    qint64 awakeMs = 0;
+    qint64 asleepMs = 0;
+    qint64 measuredWakeMs = -1;
+    int samplesTaken = 0;
+    int samplesRequested = 0;
+};
+
+#endif // SLEEPSCHEDULER_H
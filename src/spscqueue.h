@@ -0,0 +1,106 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+/** @brief Bounded lock-free queue for one producer thread and one consumer thread.
+ *
+ * push() and pop() never block and never allocate, a full queue rejects the item.
+ * The capacity is rounded up to a power of two.
+*/
+template <typename T>
+class SpscQueue
+{
+public:
+    explicit SpscQueue(size_t capacity = 4096) :
+        mask(roundUp(capacity) - 1),
+        items(mask + 1)
+    {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    /** @brief Producer side: false if the queue is full. */
+    bool push(const T &item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask) return false;
+        items[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** @brief Consumer side: false if the queue is empty. */
+    bool pop(T &item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return false;
+        item = items[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** @brief Approximate number of queued items, exact when called from either side while the other is idle. */
+    size_t size() const
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+private:
+    static size_t roundUp(size_t n)
+    {
+        size_t p = 2;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    static const size_t cacheLine = 64;
+
+    const size_t mask;
+    std::vector<T> items;
+    // head and tail on separate cache lines, producer and consumer do not share a line;
+    // padding instead of alignas(64): the queue lives in heap objects (LogWriter),
+    // operator new does not honour over-alignment before C++17
+    char pad0[cacheLine];
+    std::atomic<size_t> head;
+    char pad1[cacheLine - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> tail;
+    char pad2[cacheLine - sizeof(std::atomic<size_t>)];
+};
+
+#endif // SPSCQUEUE_H
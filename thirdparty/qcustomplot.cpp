@@ -24,6 +24,7 @@
 ****************************************************************************/
 
 #include "qcustomplot.h"
+#include <QBitArray>
 
 
 
@@ -708,6 +709,21 @@ void QCPScatterStyle::drawShape(QCPPainter *painter, double x, double y) const
   
   When a layer is deleted, the objects on it are not deleted with it, but fall on the layer below
   the deleted layer, see QCustomPlot::removeLayer.
+  
+  By default, all layers are drawn anew on every \ref QCustomPlot::replot. Layers whose content
+  rarely changes can be switched to \ref lmBuffered with \ref setMode. Such a layer renders its
+  layerables into a buffer of its own, which is then only composited into the plot. The buffer is
+  redrawn when the layer was marked dirty (\ref markDirty). QCustomPlot does this itself when
+  layerables are added to or removed from the layer, when visibilities change, when the layout or
+  the antialiasing settings change, when the user changes the selection, and when the range of an
+  axis changes (for the layers of that axis, its grid, the plottables on it and all items). Any
+  other change of an object on a buffered layer, e.g. new data or a different pen, requires a call
+  to \ref markDirty before the replot.
+  
+  For strip charts that scroll along a key axis, a buffered layer can be given a scroll axis (\ref
+  setScrollAxis). When only the range of that axis was shifted, the buffer content inside the axis
+  rect is moved by the pixel offset and only the newly exposed strip is drawn, plus the region
+  passed to \ref markDirtyFrom for newly added data.
 */
 
 /* start documentation of inline functions */
@@ -726,6 +742,21 @@ void QCPScatterStyle::drawShape(QCPPainter *painter, double x, double y) const
   Layers with higher indices will be drawn above layers with lower indices.
 */
 
+/*! \fn QCPLayer::LayerMode QCPLayer::mode() const
+  
+  Returns how this layer is rendered on a replot.
+  
+  \see setMode
+*/
+
+/*! \fn QCPAxis *QCPLayer::scrollAxis() const
+  
+  Returns the axis along which the buffer of this layer is scrolled, or 0 if the layer is always
+  redrawn completely.
+  
+  \see setScrollAxis
+*/
+
 /* end documentation of inline functions */
 
 /*!
@@ -741,7 +772,15 @@ QCPLayer::QCPLayer(QCustomPlot *parentPlot, const QString &layerName) :
   mParentPlot(parentPlot),
   mName(layerName),
   mIndex(-1), // will be set to a proper value by the QCustomPlot layer creation function
-  mVisible(true)
+  mVisible(true),
+  mMode(lmLogical),
+  mScrollAxis(0),
+  mBufferDirty(true),
+  mScrollLower(0),
+  mScrollUpper(0),
+  mScrollResidual(0),
+  mScrollDirtyKey(std::numeric_limits<double>::quiet_NaN()),
+  mScrollDirtyMargin(0)
 {
   // Note: no need to make sure layerName is unique, because layer
   // management is done with QCustomPlot functions.
@@ -772,6 +811,247 @@ QCPLayer::~QCPLayer()
 void QCPLayer::setVisible(bool visible)
 {
   mVisible = visible;
+  markDirty();
+}
+
+/*!
+  Sets how this layer is rendered on a \ref QCustomPlot::replot.
+  
+  A layer in \ref lmBuffered mode keeps its own paint buffer with the size of the plot, and only
+  redraws its layerables when it was marked dirty. Use this for layers whose content rarely
+  changes, while the plot is replotted often (e.g. for scrolling data on another layer).
+  Exports (\ref QCustomPlot::toPixmap, \ref QCustomPlot::savePdf, etc.) always draw the layerables
+  directly.
+  
+  \see markDirty
+*/
+void QCPLayer::setMode(LayerMode mode)
+{
+  if (mMode != mode)
+  {
+    mMode = mode;
+    if (mMode == lmLogical)
+      mBuffer = QPixmap(); // release the buffer memory
+    markDirty();
+  }
+}
+
+/*!
+  Sets the key \a axis along which the buffer of this layer is scrolled. Only has an effect if the
+  layer is in \ref lmBuffered mode.
+  
+  When the range of \a axis was only shifted since the last replot (same size, linear scale) and
+  nothing else on the layer changed, the buffer content inside the axis rect is moved by the
+  corresponding number of pixels, and only the exposed strip is drawn. This makes a strip chart cost
+  nearly the same per frame, independent of the number of visible points. The shift should be a
+  whole number of pixels (e.g. by moving the range in multiples of the range size divided by the
+  axis rect width), otherwise the layer is redrawn completely whenever the accumulated sub-pixel
+  error becomes visible.
+  
+  Data that is added at the leading end must be announced with \ref markDirtyFrom, any other change
+  needs a full \ref markDirty. Changes of the other axes the layerables depend on, like a rescaled
+  value axis, cause a full redraw automatically.
+  
+  Pass 0 to always redraw the layer completely.
+*/
+void QCPLayer::setScrollAxis(QCPAxis *axis)
+{
+  mScrollAxis = axis;
+  markDirty();
+}
+
+/*!
+  Marks the buffer of this layer as outdated, so it is redrawn on the next \ref
+  QCustomPlot::replot. Only has an effect if the layer is in \ref lmBuffered mode.
+  
+  Call this after changing an object on a buffered layer in a way QCustomPlot doesn't track, like
+  setting new data or a different pen. See the class documentation for the changes which mark the
+  layer dirty automatically.
+  
+  \see setMode
+*/
+void QCPLayer::markDirty()
+{
+  mBufferDirty = true;
+}
+
+/*!
+  Marks the part of a scrolling layer from \a key to the upper end of the scroll axis range as
+  outdated, e.g. after data was appended at \a key and beyond. The region is widened by \a
+  pixelMargin pixels to the side of lower keys, so it also covers the line segment from the
+  previous point and the extent of pens and scatter symbols. Repeated calls before the next replot
+  mark the union of the regions.
+  
+  If the layer has no scroll axis, this is the same as \ref markDirty.
+  
+  \see setScrollAxis
+*/
+void QCPLayer::markDirtyFrom(double key, int pixelMargin)
+{
+  if (!mScrollAxis)
+  {
+    markDirty();
+    return;
+  }
+  if (qIsNaN(mScrollDirtyKey) || key < mScrollDirtyKey)
+    mScrollDirtyKey = key;
+  mScrollDirtyMargin = qMax(mScrollDirtyMargin, pixelMargin);
+}
+
+/*! \internal
+  
+  Draws the visible layerables of this layer with \a painter, each one clipped to its \ref
+  QCPLayerable::clipRect and with its default antialiasing hint applied.
+  
+  \see drawBuffered
+*/
+void QCPLayer::draw(QCPPainter *painter)
+{
+  foreach (QCPLayerable *child, mChildren)
+  {
+    if (child->realVisibility())
+    {
+      painter->save();
+      painter->setClipRect(child->clipRect().translated(0, -1), painter->hasClipping() ? Qt::IntersectClip : Qt::ReplaceClip); // a scrolled buffer only redraws a clipped region, see drawBuffered
+      child->applyDefaultAntialiasingHint(painter);
+      child->draw(painter);
+      painter->restore();
+    }
+  }
+}
+
+/*! \internal
+  
+  Composites the buffer of this layer with \a painter. The buffer has the size of the paint device
+  of \a painter and is redrawn first if the layer was marked dirty or the size has changed. If the
+  layer only scrolled along its scroll axis, the buffer is shifted and only the exposed region is
+  redrawn (see \ref scrollBuffer).
+  
+  \see draw, markDirty, setScrollAxis
+*/
+void QCPLayer::drawBuffered(QCPPainter *painter)
+{
+  if (!mVisible)
+    return;
+  
+  QSize bufferSize(painter->device()->width(), painter->device()->height());
+  QCPAxis *axis = mScrollAxis.data();
+  QRegion region; // empty means the whole buffer
+  if (!mBufferDirty && mBuffer.size() == bufferSize)
+  {
+    if (!axis || (axis->range().lower == mScrollLower && axis->range().upper == mScrollUpper && qIsNaN(mScrollDirtyKey)))
+    {
+      painter->drawPixmap(0, 0, mBuffer);
+      return;
+    }
+    if (!scrollBuffer(axis, &region))
+      region = QRegion();
+    else if (region.isEmpty())
+    {
+      // scrolled by zero pixels and nothing new to draw:
+      mScrollLower = axis->range().lower;
+      mScrollUpper = axis->range().upper;
+      painter->drawPixmap(0, 0, mBuffer);
+      return;
+    }
+  }
+  
+  if (region.isEmpty())
+  {
+    if (mBuffer.size() != bufferSize)
+      mBuffer = QPixmap(bufferSize);
+    mBuffer.fill(Qt::transparent);
+    mScrollResidual = 0;
+  }
+  QCPPainter bufferPainter;
+  bufferPainter.begin(&mBuffer);
+  if (bufferPainter.isActive())
+  {
+    bufferPainter.setRenderHint(QPainter::HighQualityAntialiasing); // same as the paint buffer, see QCustomPlot::replot
+    if (!region.isEmpty())
+    {
+      bufferPainter.setClipRegion(region);
+      bufferPainter.setCompositionMode(QPainter::CompositionMode_Source);
+      bufferPainter.fillRect(region.boundingRect(), Qt::transparent);
+      bufferPainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    }
+    draw(&bufferPainter);
+    bufferPainter.end();
+    mBufferDirty = false;
+    if (axis)
+    {
+      mScrollLower = axis->range().lower;
+      mScrollUpper = axis->range().upper;
+    }
+    mScrollDirtyKey = std::numeric_limits<double>::quiet_NaN();
+    mScrollDirtyMargin = 0;
+  }
+  painter->drawPixmap(0, 0, mBuffer);
+}
+
+/*! \internal
+  
+  Shifts the buffer content inside the axis rect of \a axis by the pixel offset between the range
+  the buffer was drawn with and the current range of \a axis. The region that must be redrawn, i.e.
+  the exposed strip and the region marked with \ref markDirtyFrom, is returned in \a exposed.
+  
+  Returns false if the buffer can't be scrolled, because the range size or scale type doesn't allow
+  it, the shift isn't a whole number of pixels within the accumulated tolerance, or the whole axis
+  rect would be exposed anyway. The buffer is unchanged in that case and must be redrawn
+  completely.
+*/
+bool QCPLayer::scrollBuffer(QCPAxis *axis, QRegion *exposed)
+{
+  if (!axis->axisRect() || axis->scaleType() != QCPAxis::stLinear)
+    return false;
+  
+  QRect rect = axis->axisRect()->rect().translated(0, -1); // same as the clip rect of the layerables, see draw
+  bool horizontal = axis->orientation() == Qt::Horizontal;
+  int extent = horizontal ? rect.width() : rect.height();
+  double shiftLower = axis->coordToPixel(mScrollLower)-axis->coordToPixel(axis->range().lower);
+  double shiftUpper = axis->coordToPixel(mScrollUpper)-axis->coordToPixel(axis->range().upper);
+  if (qAbs(shiftUpper-shiftLower) > 0.01 || qAbs(shiftLower) >= extent)
+    return false;
+  int shift = qRound(shiftLower);
+  if (qAbs(mScrollResidual+shiftLower-shift) > 0.25) // shifted buffer content would be visibly off
+    return false;
+  mScrollResidual += shiftLower-shift;
+  
+  if (shift != 0)
+  {
+    if (horizontal)
+      mBuffer.scroll(shift, 0, rect, exposed);
+    else
+      mBuffer.scroll(0, shift, rect, exposed);
+  }
+  
+  if (!qIsNaN(mScrollDirtyKey))
+  {
+    // from the dirty key to the upper range end, limited to just outside the axis rect:
+    double lowerBorder = (horizontal ? rect.left() : rect.top())-1;
+    double upperBorder = (horizontal ? rect.right() : rect.bottom())+1;
+    double keyPixel = qBound(lowerBorder, axis->coordToPixel(mScrollDirtyKey), upperBorder);
+    double endPixel = qBound(lowerBorder, axis->coordToPixel(axis->range().upper), upperBorder);
+    int first = qFloor(qMin(keyPixel, endPixel))-mScrollDirtyMargin;
+    int last = qCeil(qMax(keyPixel, endPixel))+mScrollDirtyMargin;
+    if (horizontal)
+      *exposed += QRect(first, rect.top(), last-first+1, rect.height()) & rect;
+    else
+      *exposed += QRect(rect.left(), first, rect.width(), last-first+1) & rect;
+  }
+  return true;
+}
+
+/*! \internal
+  
+  Called by \ref QCustomPlot::updateLayerBuffers when the range of \a axis, on which layerables of
+  this layer depend, has changed. Marks the layer dirty, unless \a axis is the scroll axis, in which
+  case \ref drawBuffered scrolls the buffer instead.
+*/
+void QCPLayer::axisRangeChanged(QCPAxis *axis)
+{
+  if (!mScrollAxis || mScrollAxis.data() != axis)
+    markDirty();
 }
 
 /*! \internal
@@ -792,6 +1072,7 @@ void QCPLayer::addChild(QCPLayerable *layerable, bool prepend)
       mChildren.prepend(layerable);
     else
       mChildren.append(layerable);
+    markDirty();
   } else
     qDebug() << Q_FUNC_INFO << "layerable is already child of this layer" << reinterpret_cast<quintptr>(layerable);
 }
@@ -807,7 +1088,9 @@ void QCPLayer::addChild(QCPLayerable *layerable, bool prepend)
 */
 void QCPLayer::removeChild(QCPLayerable *layerable)
 {
-  if (!mChildren.removeOne(layerable))
+  if (mChildren.removeOne(layerable))
+    markDirty();
+  else
     qDebug() << Q_FUNC_INFO << "layerable is not child of this layer" << reinterpret_cast<quintptr>(layerable);
 }
 
@@ -953,6 +1236,8 @@ QCPLayerable::~QCPLayerable()
 void QCPLayerable::setVisible(bool on)
 {
   mVisible = on;
+  if (mLayer)
+    mLayer->markDirty();
 }
 
 /*!
@@ -4040,7 +4325,8 @@ QCPAxis::QCPAxis(QCPAxisRect *parent, AxisType type) :
   mLowestVisibleTick(0),
   mHighestVisibleTick(-1),
   mCachedMarginValid(false),
-  mCachedMargin(0)
+  mCachedMargin(0),
+  mCachedTicksValid(false)
 {
   setParent(parent);
   mGrid->setVisible(false);
@@ -4090,6 +4376,33 @@ QCPAxis::LabelSide QCPAxis::tickLabelSide() const
   return mAxisPainter->tickLabelSide;
 }
 
+/* No documentation as it is a property getter */
+int QCPAxis::tickLabelCacheBudget() const
+{
+  return mAxisPainter->cacheBudget();
+}
+
+/*!
+  Returns how many tick labels were drawn from the label cache since this axis was created.
+  
+  \see tickLabelCacheMisses, setTickLabelCacheBudget
+*/
+qint64 QCPAxis::tickLabelCacheHits() const
+{
+  return mAxisPainter->cacheHits();
+}
+
+/*!
+  Returns how many tick labels had to be rendered into a new cached pixmap since this axis was
+  created. A high miss rate compared to \ref tickLabelCacheHits on an axis with few distinct labels
+  indicates that the budget (\ref setTickLabelCacheBudget) is too small for the labels visible at
+  once.
+*/
+qint64 QCPAxis::tickLabelCacheMisses() const
+{
+  return mAxisPainter->cacheMisses();
+}
+
 /* No documentation as it is a property getter */
 QString QCPAxis::numberFormat() const
 {
@@ -4173,6 +4486,7 @@ void QCPAxis::setScaleType(QCPAxis::ScaleType type)
     if (mScaleType == stLogarithmic)
       setRange(mRange.sanitizedForLogScale());
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
     emit scaleTypeChanged(mScaleType);
   }
 }
@@ -4191,6 +4505,7 @@ void QCPAxis::setScaleLogBase(double base)
     mScaleLogBase = base;
     mScaleLogBaseLogInv = 1.0/qLn(mScaleLogBase); // buffer for faster baseLog() calculation
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   } else
     qDebug() << Q_FUNC_INFO << "Invalid logarithmic scale base (must be greater 1):" << base;
 }
@@ -4401,6 +4716,7 @@ void QCPAxis::setAutoTicks(bool on)
   {
     mAutoTicks = on;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4423,6 +4739,7 @@ void QCPAxis::setAutoTickCount(int approximateCount)
     {
       mAutoTickCount = approximateCount;
       mCachedMarginValid = false;
+      mCachedTicksValid = false;
     } else
       qDebug() << Q_FUNC_INFO << "approximateCount must be greater than zero:" << approximateCount;
   }
@@ -4449,6 +4766,7 @@ void QCPAxis::setAutoTickLabels(bool on)
   {
     mAutoTickLabels = on;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4470,6 +4788,7 @@ void QCPAxis::setAutoTickStep(bool on)
   {
     mAutoTickStep = on;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4488,6 +4807,7 @@ void QCPAxis::setAutoSubTicks(bool on)
   {
     mAutoSubTicks = on;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4558,6 +4878,8 @@ void QCPAxis::setTickLabelType(LabelType type)
   {
     mTickLabelType = type;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
+    mTickLabelCache.clear();
   }
 }
 
@@ -4620,6 +4942,21 @@ void QCPAxis::setTickLabelSide(LabelSide side)
   mCachedMarginValid = false;
 }
 
+/*!
+  Sets the memory in \a bytes the pixmaps of cached tick labels may use at most. The cache is only
+  used with the plotting hint \ref QCP::phCacheLabels (the default). When a new label exceeds the
+  budget, the least recently drawn labels are dropped. This bounds the memory on axes that show
+  ever new labels, like a scrolling date time axis, while keeping the labels that are visible from
+  one replot to the next.
+  
+  The budget should fit all labels visible at once, otherwise every replot renders them anew (see
+  \ref tickLabelCacheMisses). The default is 256 kB, enough for about a hundred typical labels.
+*/
+void QCPAxis::setTickLabelCacheBudget(int bytes)
+{
+  mAxisPainter->setCacheBudget(bytes);
+}
+
 /*!
   Sets the format in which dates and times are displayed as tick labels, if \ref setTickLabelType is \ref ltDateTime.
   for details about the \a format string, see the documentation of QDateTime::toString().
@@ -4634,6 +4971,8 @@ void QCPAxis::setDateTimeFormat(const QString &format)
   {
     mDateTimeFormat = format;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
+    mTickLabelCache.clear();
   }
 }
 
@@ -4650,6 +4989,8 @@ void QCPAxis::setDateTimeFormat(const QString &format)
 void QCPAxis::setDateTimeSpec(const Qt::TimeSpec &timeSpec)
 {
   mDateTimeSpec = timeSpec;
+  mCachedTicksValid = false;
+  mTickLabelCache.clear();
 }
 
 /*!
@@ -4696,6 +5037,8 @@ void QCPAxis::setNumberFormat(const QString &formatCode)
     return;
   }
   mCachedMarginValid = false;
+  mCachedTicksValid = false;
+  mTickLabelCache.clear();
   
   // interpret first char as number format char:
   QString allowedFormatChars(QLatin1String("eEfgG"));
@@ -4760,6 +5103,8 @@ void QCPAxis::setNumberPrecision(int precision)
   {
     mNumberPrecision = precision;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
+    mTickLabelCache.clear();
   }
 }
 
@@ -4774,6 +5119,7 @@ void QCPAxis::setTickStep(double step)
   {
     mTickStep = step;
     mCachedMarginValid = false;
+    mCachedTicksValid = false;
   }
 }
 
@@ -4795,6 +5141,7 @@ void QCPAxis::setTickVector(const QVector<double> &vec)
   // don't check whether mTickVector != vec here, because it takes longer than we would save
   mTickVector = vec;
   mCachedMarginValid = false;
+  mCachedTicksValid = false;
 }
 
 /*!
@@ -4813,6 +5160,7 @@ void QCPAxis::setTickVectorLabels(const QVector<QString> &vec)
   // don't check whether mTickVectorLabels != vec here, because it takes longer than we would save
   mTickVectorLabels = vec;
   mCachedMarginValid = false;
+  mCachedTicksValid = false;
 }
 
 /*!
@@ -4873,6 +5221,7 @@ void QCPAxis::setTickLengthOut(int outside)
 void QCPAxis::setSubTickCount(int count)
 {
   mSubTickCount = count;
+  mCachedTicksValid = false;
 }
 
 /*!
@@ -5510,12 +5859,31 @@ QCPAxis::AxisType QCPAxis::opposite(QCPAxis::AxisType type)
   \ref setAutoTicks is set to true, appropriate tick values are determined automatically via \ref
   generateAutoTicks. If it's set to false, the signal ticksRequest is emitted, which can be used to
   provide external tick positions. Then the sub tick vectors and tick label vectors are created.
+  
+  With automatic ticks and tick labels, the vectors are only regenerated when the range or a tick
+  setting has changed since the last call. Labels are looked up by tick coordinate in the labels of
+  the last call first, so a scrolling axis only formats the labels of ticks that newly appeared.
+  (The tick step doesn't depend on the axis length in pixels, so resizing the axis keeps the
+  cached ticks.)
 */
 void QCPAxis::setupTickVectors()
 {
   if (!mParentPlot) return;
   if ((!mTicks && !mTickLabels && !mGrid->visible()) || mRange.size() <= 0) return;
   
+  // automatic ticks and labels only depend on the range and the tick settings (whose setters reset
+  // mCachedTicksValid), so they are reused as long as those didn't change:
+  bool autoGenerated = mAutoTicks && mAutoTickLabels;
+  if (autoGenerated && mCachedTicksValid && mRange == mCachedTickRange && mParentPlot->locale() == mCachedTickLocale)
+    return;
+  if (mParentPlot->locale() != mCachedTickLocale)
+  {
+    mCachedTickLocale = mParentPlot->locale();
+    mTickLabelCache.clear();
+  }
+  mCachedTicksValid = autoGenerated;
+  mCachedTickRange = mRange;
+  
   // fill tick vectors, either by auto generating or by notifying user to fill the vectors himself
   if (mAutoTicks)
   {
@@ -5563,26 +5931,20 @@ void QCPAxis::setupTickVectors()
     mSubTickVector.resize(subTickIndex);
   }
 
-  // generate tick labels according to tick positions:
+  // generate tick labels according to tick positions. Labels of ticks that were already visible
+  // in the previous call are taken from mTickLabelCache, which then only keeps the current ones:
   if (mAutoTickLabels)
   {
     int vecsize = mTickVector.size();
     mTickVectorLabels.resize(vecsize);
-    if (mTickLabelType == ltNumber)
+    QMap<double, QString> labelCache;
+    for (int i=mLowestVisibleTick; i<=mHighestVisibleTick; ++i)
     {
-      for (int i=mLowestVisibleTick; i<=mHighestVisibleTick; ++i)
-        mTickVectorLabels[i] = mParentPlot->locale().toString(mTickVector.at(i), mNumberFormatChar.toLatin1(), mNumberPrecision);
-    } else if (mTickLabelType == ltDateTime)
-    {
-      for (int i=mLowestVisibleTick; i<=mHighestVisibleTick; ++i)
-      {
-#if QT_VERSION < QT_VERSION_CHECK(4, 7, 0) // use fromMSecsSinceEpoch function if available, to gain sub-second accuracy on tick labels (e.g. for format "hh:mm:ss:zzz")
-        mTickVectorLabels[i] = mParentPlot->locale().toString(QDateTime::fromTime_t(mTickVector.at(i)).toTimeSpec(mDateTimeSpec), mDateTimeFormat);
-#else
-        mTickVectorLabels[i] = mParentPlot->locale().toString(QDateTime::fromMSecsSinceEpoch(mTickVector.at(i)*1000).toTimeSpec(mDateTimeSpec), mDateTimeFormat);
-#endif
-      }
+      QMap<double, QString>::const_iterator it = mTickLabelCache.constFind(mTickVector.at(i));
+      mTickVectorLabels[i] = it != mTickLabelCache.constEnd() ? it.value() : tickLabel(mTickVector.at(i));
+      labelCache.insert(mTickVector.at(i), mTickVectorLabels.at(i));
     }
+    mTickLabelCache.swap(labelCache);
   } else // mAutoTickLabels == false
   {
     if (mAutoTicks) // ticks generated automatically, but not ticklabels, so emit ticksRequest here for labels
@@ -5595,6 +5957,26 @@ void QCPAxis::setupTickVectors()
   }
 }
 
+/*! \internal
+  
+  Returns the automatic tick label of the tick at coordinate \a tick, according to the tick label
+  type, the number or date time format and the locale of the parent plot.
+  
+  \see setupTickVectors
+*/
+QString QCPAxis::tickLabel(double tick) const
+{
+  if (mTickLabelType == ltDateTime)
+  {
+#if QT_VERSION < QT_VERSION_CHECK(4, 7, 0) // use fromMSecsSinceEpoch function if available, to gain sub-second accuracy on tick labels (e.g. for format "hh:mm:ss:zzz")
+    return mParentPlot->locale().toString(QDateTime::fromTime_t(tick).toTimeSpec(mDateTimeSpec), mDateTimeFormat);
+#else
+    return mParentPlot->locale().toString(QDateTime::fromMSecsSinceEpoch(tick*1000).toTimeSpec(mDateTimeSpec), mDateTimeFormat);
+#endif
+  }
+  return mParentPlot->locale().toString(tick, mNumberFormatChar.toLatin1(), mNumberPrecision);
+}
+
 /*! \internal
   
   If \ref setAutoTicks is set to true, this function is called by \ref setupTickVectors to
@@ -6080,7 +6462,9 @@ QCPAxisPainterPrivate::QCPAxisPainterPrivate(QCustomPlot *parentPlot) :
   abbreviateDecimalPowers(false),
   reversedEndings(false),
   mParentPlot(parentPlot),
-  mLabelCache(16) // cache at most 16 (tick) labels
+  mLabelCache(256*1024), // bytes of cached label pixmaps
+  mLabelCacheHits(0),
+  mLabelCacheMisses(0)
 {
 }
 
@@ -6332,6 +6716,16 @@ void QCPAxisPainterPrivate::clearCache()
   mLabelCache.clear();
 }
 
+/*! \internal
+  
+  Sets the memory the cached label pixmaps may use at most, in \a bytes. If the cache currently
+  holds more, the least recently used labels are dropped.
+*/
+void QCPAxisPainterPrivate::setCacheBudget(int bytes)
+{
+  mLabelCache.setMaxCost(qMax(0, bytes));
+}
+
 /*! \internal
   
   Returns a hash that allows uniquely identifying whether the label parameters have changed such
@@ -6386,8 +6780,11 @@ void QCPAxisPainterPrivate::placeTickLabel(QCPPainter *painter, double position,
   if (mParentPlot->plottingHints().testFlag(QCP::phCacheLabels) && !painter->modes().testFlag(QCPPainter::pmNoCaching)) // label caching enabled
   {
     CachedLabel *cachedLabel = mLabelCache.take(text); // attempt to get label from cache
-    if (!cachedLabel)  // no cached label existed, create it
+    if (cachedLabel)
+      ++mLabelCacheHits;
+    else // no cached label existed, create it
     {
+      ++mLabelCacheMisses;
       cachedLabel = new CachedLabel;
       TickLabelData labelData = getTickLabelData(painter->font(), text);
       cachedLabel->offset = getTickLabelDrawOffset(labelData)+labelData.rotatedTotalBounds.topLeft();
@@ -6411,7 +6808,10 @@ void QCPAxisPainterPrivate::placeTickLabel(QCPPainter *painter, double position,
       painter->drawPixmap(labelAnchor+cachedLabel->offset, cachedLabel->pixmap);
       finalSize = cachedLabel->pixmap.size();
     }
-    mLabelCache.insert(text, cachedLabel); // return label to cache or insert for the first time if newly created
+    // return label to cache or insert for the first time if newly created. Labels larger than the
+    // whole budget are deleted right away by QCache, cachedLabel must not be used after this:
+    int cost = qMax(1, cachedLabel->pixmap.width()*cachedLabel->pixmap.height()*qMax(1, cachedLabel->pixmap.depth()/8));
+    mLabelCache.insert(text, cachedLabel, cost);
   } else // label caching disabled, draw text directly on surface:
   {
     TickLabelData labelData = getTickLabelData(painter->font(), text);
@@ -8935,6 +9335,21 @@ QCP::Interaction QCPAbstractItem::selectionCategory() const
   \see replot, beforeReplot
 */
 
+/*! \fn void QCustomPlot::imageRendered(const QImage &image)
+  
+  This signal is emitted when an image requested with \ref toImageAsync has been rendered.
+  
+  \see toImageAsync
+*/
+
+/*! \fn void QCustomPlot::imageSaved(const QString &fileName, bool success)
+  
+  This signal is emitted when a file requested with \ref saveRasteredAsync has been written (\a
+  success is true) or couldn't be written.
+  
+  \see saveRasteredAsync
+*/
+
 /* end of documentation of signals */
 /* start of documentation of public members */
 
@@ -10813,6 +11228,7 @@ void QCustomPlot::mouseReleaseEvent(QMouseEvent *event)
       if (selectionStateChanged)
       {
         doReplot = true;
+        markBufferedLayersDirty();
         emit selectionChangedByUser();
       }
     }
@@ -10881,20 +11297,17 @@ void QCustomPlot::draw(QCPPainter *painter)
   // draw viewport background pixmap:
   drawBackground(painter);
 
-  // draw all layered objects (grid, axes, plottables, items, legend,...):
+  // draw all layered objects (grid, axes, plottables, items, legend,...). Buffered layers are only
+  // composited when drawing on screen, exports draw every layer directly:
+  bool onScreen = painter->device() == &mPaintBuffer;
+  if (onScreen)
+    updateLayerBuffers();
   foreach (QCPLayer *layer, mLayers)
   {
-    foreach (QCPLayerable *child, layer->children())
-    {
-      if (child->realVisibility())
-      {
-        painter->save();
-        painter->setClipRect(child->clipRect().translated(0, -1));
-        child->applyDefaultAntialiasingHint(painter);
-        child->draw(painter);
-        painter->restore();
-      }
-    }
+    if (onScreen && layer->mode() == QCPLayer::lmBuffered)
+      layer->drawBuffered(painter);
+    else
+      layer->draw(painter);
   }
   
   /* Debug code to draw all layout element rects
@@ -10991,6 +11404,84 @@ void QCustomPlot::updateLayerIndices() const
     mLayers.at(i)->mIndex = i;
 }
 
+/*! \internal
+  
+  Marks the buffered layers dirty (\ref QCPLayer::markDirty) whose content changed since the last
+  replot on screen, as far as QCustomPlot can tell: A change of the axis rect layout or of the
+  antialiasing settings affects all layers. A changed axis range affects the layers of the axis, its
+  grid, the plottables on that axis and all items (whose positions may depend on the axis via
+  anchors). Layers scrolling along the changed axis only redraw the exposed part, see \ref
+  QCPLayer::setScrollAxis.
+  
+  Must be called after the layout update of a replot, so the axis rects have their final size.
+  
+  \see QCPLayer::setMode
+*/
+void QCustomPlot::updateLayerBuffers()
+{
+  QList<QRect> axisRectRects;
+  QHash<QCPAxis*, QCPRange> axisRanges;
+  QList<QCPAxis*> changedAxes;
+  foreach (QCPAxisRect *axisRect, axisRects())
+  {
+    axisRectRects.append(axisRect->rect());
+    foreach (QCPAxis *axis, axisRect->axes())
+    {
+      axisRanges.insert(axis, axis->range());
+      QHash<QCPAxis*, QCPRange>::const_iterator it = mBufferedAxisRanges.constFind(axis);
+      if (it == mBufferedAxisRanges.constEnd() || it.value() != axis->range())
+        changedAxes.append(axis);
+    }
+  }
+  
+  if (axisRectRects != mBufferedAxisRectRects ||
+      mAntialiasedElements != mBufferedAntialiasedElements ||
+      mNotAntialiasedElements != mBufferedNotAntialiasedElements)
+  {
+    markBufferedLayersDirty();
+  } else if (!changedAxes.isEmpty())
+  {
+    foreach (QCPAxis *axis, changedAxes)
+    {
+      if (axis->layer())
+        axis->layer()->markDirty();
+      if (axis->grid()->layer())
+        axis->grid()->layer()->axisRangeChanged(axis);
+    }
+    foreach (QCPAbstractPlottable *plottable, mPlottables)
+    {
+      if (!plottable->layer())
+        continue;
+      if (changedAxes.contains(plottable->keyAxis()))
+        plottable->layer()->axisRangeChanged(plottable->keyAxis());
+      if (changedAxes.contains(plottable->valueAxis()))
+        plottable->layer()->axisRangeChanged(plottable->valueAxis());
+    }
+    foreach (QCPAbstractItem *item, mItems)
+    {
+      if (item->layer())
+        item->layer()->markDirty();
+    }
+  }
+  
+  mBufferedAxisRectRects = axisRectRects;
+  mBufferedAxisRanges = axisRanges;
+  mBufferedAntialiasedElements = mAntialiasedElements;
+  mBufferedNotAntialiasedElements = mNotAntialiasedElements;
+}
+
+/*! \internal
+  
+  Marks all layers dirty, so the buffered ones are redrawn on the next replot.
+  
+  \see QCPLayer::markDirty
+*/
+void QCustomPlot::markBufferedLayersDirty()
+{
+  foreach (QCPLayer *layer, mLayers)
+    layer->markDirty();
+}
+
 /*! \internal
   
   Returns the layerable at pixel position \a pos. If \a onlySelectable is set to true, only those
@@ -11038,7 +11529,7 @@ QCPLayerable *QCustomPlot::layerableAt(const QPointF &pos, bool onlySelectable,
   Returns true on success. If this function fails, most likely the given \a format isn't supported
   by the system, see Qt docs about QImageWriter::supportedImageFormats().
   
-  \see saveBmp, saveJpg, savePng, savePdf
+  \see saveBmp, saveJpg, savePng, savePdf, saveRasteredAsync
 */
 bool QCustomPlot::saveRastered(const QString &fileName, int width, int height, double scale, const char *format, int quality)
 {
@@ -11055,7 +11546,7 @@ bool QCustomPlot::saveRastered(const QString &fileName, int width, int height, d
   The plot is sized to \a width and \a height in pixels and scaled with \a scale. (width 100 and
   scale 2.0 lead to a full resolution pixmap with width 200.)
   
-  \see toPainter, saveRastered, saveBmp, savePng, saveJpg, savePdf
+  \see toPainter, toImageAsync, saveRastered, saveBmp, savePng, saveJpg, savePdf
 */
 QPixmap QCustomPlot::toPixmap(int width, int height, double scale)
 {
@@ -11140,58 +11631,211 @@ void QCustomPlot::toPainter(QCPPainter *painter, int width, int height)
     qDebug() << Q_FUNC_INFO << "Passed painter is not active";
 }
 
-
-////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////// QCPColorGradient
-////////////////////////////////////////////////////////////////////////////////////////////////////
-
-/*! \class QCPColorGradient
-  \brief Defines a color gradient for use with e.g. \ref QCPColorMap
-  
-  This class describes a color gradient which can be used to encode data with color. For example,
-  QCPColorMap and QCPColorScale have \ref QCPColorMap::setGradient "setGradient" methods which
-  take an instance of this class. Colors are set with \ref setColorStopAt(double position, const QColor &color)
-  with a \a position from 0 to 1. In between these defined color positions, the
-  color will be interpolated linearly either in RGB or HSV space, see \ref setColorInterpolation.
-
-  Alternatively, load one of the preset color gradients shown in the image below, with \ref
-  loadPreset, or by directly specifying the preset in the constructor.
+/*!
+  Renders the plot to an image on a thread of the global QThreadPool and emits \ref imageRendered
+  with the result. The parameters are the same as for \ref toPixmap.
   
-  \image html QCPColorGradient.png
+  Only the drawing commands are recorded on the calling (GUI) thread, which is cheap. The
+  expensive part, rasterizing them with antialiasing into a QImage, happens on the worker thread,
+  so large exports don't block the event loop. Changes to the plot after this call don't affect the
+  image.
   
-  The fact that the \ref QCPColorGradient(GradientPreset preset) constructor allows directly
-  converting a \ref GradientPreset to a QCPColorGradient, you can also directly pass \ref
-  GradientPreset to all the \a setGradient methods, e.g.:
-  \snippet documentation/doc-code-snippets/mainwindow.cpp qcpcolorgradient-setgradient
+  \note Plots that contain pixmaps (a background pixmap, \ref QCPScatterStyle::ssPixmap scatters
+  or \ref QCPItemPixmap items) need a platform that supports pixmaps outside the GUI thread. Use
+  the synchronous \ref toPixmap otherwise.
   
-  The total number of levels used in the gradient can be set with \ref setLevelCount. Whether the
-  color gradient shall be applied periodically (wrapping around) to data values that lie outside
-  the data range specified on the plottable instance can be controlled with \ref setPeriodic.
+  \see saveRasteredAsync
 */
+void QCustomPlot::toImageAsync(int width, int height, double scale)
+{
+  QSize imageSize;
+  QPicture picture = toPicture(width, height, scale, &imageSize);
+  if (picture.isNull())
+    return;
+  QCPImageRenderJob *job = new QCPImageRenderJob(picture, imageSize, scale);
+  connect(job, SIGNAL(rendered(QImage)), this, SIGNAL(imageRendered(QImage)), Qt::QueuedConnection);
+  QThreadPool::globalInstance()->start(job);
+}
 
 /*!
-  Constructs a new QCPColorGradient initialized with the colors and color interpolation according
-  to \a preset.
+  Saves the plot to a rastered image file like \ref saveRastered, but rasterizes and encodes it on
+  a thread of the global QThreadPool (see \ref toImageAsync). When the file is written, \ref
+  imageSaved is emitted with \a fileName and whether saving succeeded.
   
-  The color level count is initialized to 350.
+  \see toImageAsync
 */
-QCPColorGradient::QCPColorGradient(GradientPreset preset) :
-  mLevelCount(350),
-  mColorInterpolation(ciRGB),
-  mPeriodic(false),
-  mColorBufferInvalidated(true)
+void QCustomPlot::saveRasteredAsync(const QString &fileName, int width, int height, double scale, const char *format, int quality)
 {
-  mColorBuffer.fill(qRgb(0, 0, 0), mLevelCount);
-  loadPreset(preset);
+  QSize imageSize;
+  QPicture picture = toPicture(width, height, scale, &imageSize);
+  if (picture.isNull())
+  {
+    emit imageSaved(fileName, false);
+    return;
+  }
+  QCPImageRenderJob *job = new QCPImageRenderJob(picture, imageSize, scale, fileName, format, quality);
+  connect(job, SIGNAL(saved(QString,bool)), this, SIGNAL(imageSaved(QString,bool)), Qt::QueuedConnection);
+  QThreadPool::globalInstance()->start(job);
 }
 
-/* undocumented operator */
-bool QCPColorGradient::operator==(const QCPColorGradient &other) const
+/*! \internal
+  
+  Records the drawing commands of the plot into a QPicture, for rasterizing it on another thread
+  (see \ref toImageAsync). The plot is sized to \a width and \a height like in \ref toPixmap, the
+  scale is only applied when the picture is played back. Pens are made non-cosmetic for \a scale
+  greater than 1 already here though, like toPixmap does.
+  
+  The size of the image the picture should be played back into is returned in \a imageSize.
+  Returns a null picture if the plot or the image would be empty.
+*/
+QPicture QCustomPlot::toPicture(int width, int height, double scale, QSize *imageSize)
 {
-  return ((other.mLevelCount == this->mLevelCount) &&
-          (other.mColorInterpolation == this->mColorInterpolation) &&
-          (other.mPeriodic == this->mPeriodic) &&
-          (other.mColorStops == this->mColorStops));
+  int newWidth, newHeight;
+  if (width == 0 || height == 0)
+  {
+    newWidth = this->width();
+    newHeight = this->height();
+  } else
+  {
+    newWidth = width;
+    newHeight = height;
+  }
+  *imageSize = QSize(qRound(scale*newWidth), qRound(scale*newHeight));
+  if (imageSize->isEmpty())
+  {
+    qDebug() << Q_FUNC_INFO << "Image would have width or height zero";
+    return QPicture();
+  }
+  
+  QPicture picture;
+  QCPPainter painter;
+  painter.begin(&picture);
+  if (scale > 1.0 && !qFuzzyCompare(scale, 1.0)) // for scale < 1 we always want cosmetic pens where possible, see toPixmap
+    painter.setMode(QCPPainter::pmNonCosmetic);
+  toPainter(&painter, newWidth, newHeight);
+  painter.end();
+  return picture;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPImageRenderJob
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPImageRenderJob
+  \brief Rasterizes a recorded plot into a QImage on a worker thread
+  
+  This class is used by \ref QCustomPlot::toImageAsync and \ref QCustomPlot::saveRasteredAsync.
+  It plays back the drawing commands QCustomPlot recorded into a QPicture, so it doesn't touch any
+  plot objects and is safe to run on a thread of a QThreadPool. The job deletes itself after it
+  has run.
+  
+  Depending on whether a file name was passed to the constructor, \ref rendered is emitted with the
+  image, or the image is encoded to the file and \ref saved is emitted. The signals are emitted from
+  the worker thread, connect them with a queued connection.
+*/
+
+/* start documentation of signals */
+
+/*! \fn void QCPImageRenderJob::rendered(const QImage &image)
+  
+  This signal is emitted when the image was rendered and no file name was given.
+*/
+
+/*! \fn void QCPImageRenderJob::saved(const QString &fileName, bool success)
+  
+  This signal is emitted when the image was rendered and encoded to \a fileName. \a success is
+  false if the file couldn't be written, e.g. because the format isn't supported.
+*/
+
+/* end documentation of signals */
+
+/*!
+  Creates a job that plays back \a picture, scaled with \a scale, into an image of \a size. If
+  \a fileName isn't empty, the image is saved there in \a format with \a quality (see
+  QImage::save).
+*/
+QCPImageRenderJob::QCPImageRenderJob(const QPicture &picture, const QSize &size, double scale, const QString &fileName, const char *format, int quality) :
+  mPicture(picture),
+  mSize(size),
+  mScale(scale),
+  mFileName(fileName),
+  mFormat(format),
+  mQuality(quality)
+{
+  setAutoDelete(true);
+}
+
+/* inherits documentation from base class */
+void QCPImageRenderJob::run()
+{
+  // the background of the plot is part of the picture, see QCustomPlot::toPainter:
+  QImage image(mSize, QImage::Format_ARGB32_Premultiplied);
+  image.fill(Qt::transparent);
+  QPainter painter(&image);
+  if (!qFuzzyCompare(mScale, 1.0))
+    painter.scale(mScale, mScale);
+  painter.drawPicture(0, 0, mPicture);
+  painter.end();
+  
+  if (mFileName.isEmpty())
+    emit rendered(image);
+  else
+    emit saved(mFileName, image.save(mFileName, mFormat.isEmpty() ? 0 : mFormat.constData(), mQuality));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPColorGradient
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPColorGradient
+  \brief Defines a color gradient for use with e.g. \ref QCPColorMap
+  
+  This class describes a color gradient which can be used to encode data with color. For example,
+  QCPColorMap and QCPColorScale have \ref QCPColorMap::setGradient "setGradient" methods which
+  take an instance of this class. Colors are set with \ref setColorStopAt(double position, const QColor &color)
+  with a \a position from 0 to 1. In between these defined color positions, the
+  color will be interpolated linearly either in RGB or HSV space, see \ref setColorInterpolation.
+
+  Alternatively, load one of the preset color gradients shown in the image below, with \ref
+  loadPreset, or by directly specifying the preset in the constructor.
+  
+  \image html QCPColorGradient.png
+  
+  The fact that the \ref QCPColorGradient(GradientPreset preset) constructor allows directly
+  converting a \ref GradientPreset to a QCPColorGradient, you can also directly pass \ref
+  GradientPreset to all the \a setGradient methods, e.g.:
+  \snippet documentation/doc-code-snippets/mainwindow.cpp qcpcolorgradient-setgradient
+  
+  The total number of levels used in the gradient can be set with \ref setLevelCount. Whether the
+  color gradient shall be applied periodically (wrapping around) to data values that lie outside
+  the data range specified on the plottable instance can be controlled with \ref setPeriodic.
+*/
+
+/*!
+  Constructs a new QCPColorGradient initialized with the colors and color interpolation according
+  to \a preset.
+  
+  The color level count is initialized to 350.
+*/
+QCPColorGradient::QCPColorGradient(GradientPreset preset) :
+  mLevelCount(350),
+  mColorInterpolation(ciRGB),
+  mPeriodic(false),
+  mColorBufferInvalidated(true)
+{
+  mColorBuffer.fill(qRgb(0, 0, 0), mLevelCount);
+  loadPreset(preset);
+}
+
+/* undocumented operator */
+bool QCPColorGradient::operator==(const QCPColorGradient &other) const
+{
+  return ((other.mLevelCount == this->mLevelCount) &&
+          (other.mColorInterpolation == this->mColorInterpolation) &&
+          (other.mPeriodic == this->mPeriodic) &&
+          (other.mColorStops == this->mColorStops));
 }
 
 /*!
@@ -14417,179 +15061,869 @@ QCPData::QCPData(double key, double value) :
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-//////////////////// QCPGraph
+//////////////////// QCPDataContainer
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-/*! \class QCPGraph
-  \brief A plottable representing a graph in a plot.
-
-  \image html QCPGraph.png
-  
-  Usually you create new graphs by calling QCustomPlot::addGraph. The resulting instance can be
-  accessed via QCustomPlot::graph.
-
-  To plot data, assign it with the \ref setData or \ref addData functions. Alternatively, you can
-  also access and modify the graph's data via the \ref data method, which returns a pointer to the
-  internal \ref QCPDataMap.
-  
-  Graphs are used to display single-valued data. Single-valued means that there should only be one
-  data point per unique key coordinate. In other words, the graph can't have \a loops. If you do
-  want to plot non-single-valued curves, rather use the QCPCurve plottable.
+/*! \class QCPDataContainer
+  \brief Sorted, contiguous container of QCPData points, the data storage of QCPGraph.
   
-  Gaps in the graph line can be created by adding data points with NaN as value
-  (<tt>qQNaN()</tt> or <tt>std::numeric_limits<double>::quiet_NaN()</tt>) in between the two data points that shall be
-  separated.
-  
-  \section appearance Changing the appearance
-  
-  The appearance of the graph is mainly determined by the line style, scatter style, brush and pen
-  of the graph (\ref setLineStyle, \ref setScatterStyle, \ref setBrush, \ref setPen).
+  The points are kept in a QVector in ascending key order, so iterating the data touches
+  contiguous memory and range lookups (\ref lowerBound, \ref upperBound) are binary searches.
+  The interface follows QMap<double, QCPData>, which was used before (see \ref QCPDataMap).
   
-  \subsection filling Filling under or between graphs
+  Appending a point with a key not smaller than the last key (the usual case for realtime data)
+  is amortized O(1). Erasing points from the front, as \ref QCPGraph::removeDataBefore does for
+  scrolling plots, only moves the start index; the unused space is reclaimed once it makes up
+  half of the vector. Inserting or erasing in the middle is O(n).
   
-  QCPGraph knows two types of fills: Normal graph fills towards the zero-value-line parallel to
-  the key axis of the graph, and fills between two graphs, called channel fills. To enable a fill,
-  just set a brush with \ref setBrush which is neither Qt::NoBrush nor fully transparent.
+  Multiple points with the same key are allowed (see \ref insertMulti), they are kept in
+  insertion order.
   
-  By default, a normal fill towards the zero-value-line will be drawn. To set up a channel fill
-  between this graph and another one, call \ref setChannelFillGraph with the other graph as
-  parameter.
-
-  \see QCustomPlot::addGraph, QCustomPlot::graph
+  Iterators are invalidated by all modifying operations.
 */
 
-/* start of documentation of inline functions */
+/*! \internal
+  Comparators for the binary searches of QCPDataContainer on the key member of QCPData.
+*/
+static bool qcpLessThanKey(const QCPData &data, double key) { return data.key < key; }
+static bool qcpKeyLessThan(double key, const QCPData &data) { return key < data.key; }
+static bool qcpLessThanSortKey(const QCPData &a, const QCPData &b) { return a.key < b.key; }
 
-/*! \fn QCPDataMap *QCPGraph::data() const
-  
-  Returns a pointer to the internal data storage of type \ref QCPDataMap. You may use it to
-  directly manipulate the data, which may be more convenient and faster than using the regular \ref
-  setData or \ref addData methods, in certain situations.
+/*! \internal
+  Widens the value range \a range to include \a other. Ranges with NaN bounds stand for "no value"
+  in the min/max pyramid of QCPDataContainer.
 */
+static void qcpUniteValueRange(QCPRange &range, const QCPRange &other)
+{
+  if (qIsNaN(other.lower))
+    return;
+  if (qIsNaN(range.lower))
+  {
+    range = other;
+  } else
+  {
+    range.lower = qMin(range.lower, other.lower);
+    range.upper = qMax(range.upper, other.upper);
+  }
+}
 
-/* end of documentation of inline functions */
+static const int qcpValueLevelShift = 4; // the lowest level of the min/max pyramid has one range per 16 points
 
 /*!
-  Constructs a graph which uses \a keyAxis as its key axis ("x") and \a valueAxis as its value
-  axis ("y"). \a keyAxis and \a valueAxis must reside in the same QCustomPlot instance and not have
-  the same orientation. If either of these restrictions is violated, a corresponding message is
-  printed to the debug output (qDebug), the construction is not aborted, though.
-  
-  The constructed QCPGraph can be added to the plot with QCustomPlot::addPlottable, QCustomPlot
-  then takes ownership of the graph.
-  
-  To directly create a graph inside a plot, you can also use the simpler QCustomPlot::addGraph function.
+  Constructs an empty container.
 */
-QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
-  QCPAbstractPlottable(keyAxis, valueAxis)
+QCPDataContainer::QCPDataContainer() :
+  mBegin(0),
+  mBoundsValid(true),
+  mBoundsFound(false),
+  mHasKeyErrors(false),
+  mHasValueErrors(false),
+  mValueLower(0),
+  mValueUpper(0),
+  mKeyErrorLower(0),
+  mKeyErrorUpper(0),
+  mValueErrorLower(0),
+  mValueErrorUpper(0),
+  mValueBinsValid(false),
+  mValueBinLower(0),
+  mValueBinUpper(0),
+  mValueBinWidth(1),
+  mValueLevelsValid(false)
 {
-  mData = new QCPDataMap;
-  
-  setPen(QPen(Qt::blue, 0));
-  setErrorPen(QPen(Qt::black));
-  setBrush(Qt::NoBrush);
-  setSelectedPen(QPen(QColor(80, 80, 255), 2.5));
-  setSelectedBrush(Qt::NoBrush);
-  
-  setLineStyle(lsLine);
-  setErrorType(etNone);
-  setErrorBarSize(6);
-  setErrorBarSkipSymbol(true);
-  setChannelFillGraph(0);
-  setAdaptiveSampling(true);
 }
 
-QCPGraph::~QCPGraph()
+/*!
+  Returns the keys of all data points in ascending order.
+*/
+QList<double> QCPDataContainer::keys() const
 {
-  delete mData;
+  QList<double> result;
+  result.reserve(size());
+  for (const_iterator it = constBegin(); it != constEnd(); ++it)
+    result.append(it.key());
+  return result;
 }
 
 /*!
-  Replaces the current data with the provided \a data.
-  
-  If \a copy is set to true, data points in \a data will only be copied. if false, the graph
-  takes ownership of the passed data and replaces the internal data pointer with it. This is
-  significantly faster than copying for large datasets.
-  
-  Alternatively, you can also access and modify the graph's data via the \ref data method, which
-  returns a pointer to the internal \ref QCPDataMap.
+  Returns all data points in ascending key order.
 */
-void QCPGraph::setData(QCPDataMap *data, bool copy)
+QList<QCPData> QCPDataContainer::values() const
 {
-  if (mData == data)
-  {
-    qDebug() << Q_FUNC_INFO << "The data pointer is already in (and owned by) this plottable" << reinterpret_cast<quintptr>(data);
-    return;
-  }
-  if (copy)
-  {
-    *mData = *data;
-  } else
-  {
-    delete mData;
-    mData = data;
-  }
+  QList<QCPData> result;
+  result.reserve(size());
+  for (const_iterator it = constBegin(); it != constEnd(); ++it)
+    result.append(it.value());
+  return result;
 }
 
-/*! \overload
+/*!
+  Returns the key range spanned by the data points that have a non-NaN value, including their key
+  error bars if \a includeErrors is true. \a foundRange is set to false if there is no such point.
   
-  Replaces the current data with the provided points in \a key and \a value pairs. The provided
-  vectors should have equal length. Else, the number of added points will be the size of the
-  smallest vector.
+  Without key error bars this only looks at the ends of the container. The range including error
+  bars is cached, see \ref valueRange.
+  
+  \see QCPGraph::getKeyRange
 */
-void QCPGraph::setData(const QVector<double> &key, const QVector<double> &value)
+QCPRange QCPDataContainer::keyRange(bool &foundRange, bool includeErrors) const
 {
-  mData->clear();
-  int n = key.size();
-  n = qMin(n, value.size());
-  QCPData newData;
-  for (int i=0; i<n; ++i)
-  {
-    newData.key = key[i];
-    newData.value = value[i];
-    mData->insertMulti(newData.key, newData);
-  }
+  if (!includeErrors)
+    return plainKeyRange(foundRange);
+  updateBounds();
+  if (!mHasKeyErrors)
+    return plainKeyRange(foundRange);
+  foundRange = mBoundsFound;
+  return QCPRange(mKeyErrorLower, mKeyErrorUpper);
 }
 
 /*!
-  Replaces the current data with the provided points in \a key and \a value pairs. Additionally the
-  symmetrical value error of the data points are set to the values in \a valueError.
-  For error bars to show appropriately, see \ref setErrorType.
-  The provided vectors should have equal length. Else, the number of added points will be the size of the
-  smallest vector.
+  Returns the value range spanned by the data points that have a non-NaN value, including their
+  value error bars if \a includeErrors is true. \a foundRange is set to false if there is no such
+  point.
   
-  For asymmetrical errors (plus different from minus), see the overloaded version of this function.
+  The bounds are cached: adding points only widens them, and removing points only drops the cache
+  if a removed point lies on the current bounds. So for a scrolling plot that appends new points
+  and removes old ones, this is O(1) most of the time. Getting a non-const iterator (\ref begin,
+  \ref end, \ref find, \ref lowerBound, \ref upperBound) also drops the cache, since points may be
+  changed through it.
+  
+  \see QCPGraph::getValueRange
 */
-void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &valueError)
+QCPRange QCPDataContainer::valueRange(bool &foundRange, bool includeErrors) const
 {
-  mData->clear();
-  int n = key.size();
-  n = qMin(n, value.size());
-  n = qMin(n, valueError.size());
-  QCPData newData;
-  for (int i=0; i<n; ++i)
-  {
-    newData.key = key[i];
-    newData.value = value[i];
-    newData.valueErrorMinus = valueError[i];
-    newData.valueErrorPlus = valueError[i];
-    mData->insertMulti(key[i], newData);
+  updateBounds();
+  foundRange = mBoundsFound;
+  if (includeErrors && mHasValueErrors)
+    return QCPRange(mValueErrorLower, mValueErrorUpper);
+  return QCPRange(mValueLower, mValueUpper);
+}
+
+/*! \overload
+  
+  Returns the value range of the data points from \a first up to (excluding) \a last, ignoring
+  points with NaN value. \a foundRange is set to false if there is no such point.
+  
+  This reads a min/max pyramid of the values (ranges of 16, 32, 64, ... consecutive points), so it
+  only visits O(log n) ranges instead of every point. \ref QCPGraph uses it for adaptive sampling,
+  where it is called once per pixel. The pyramid is built on the first call and then kept up to
+  date while points are appended or removed from the front; other changes drop it.
+*/
+QCPRange QCPDataContainer::valueRange(const_iterator first, const_iterator last, bool &foundRange) const
+{
+  if (!mValueLevelsValid)
+    buildValueLevels();
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  QCPRange result(nan, nan);
+  int from = first.operator->()-mData.constData();
+  int to = last.operator->()-mData.constData();
+  while (from < to)
+  {
+    // use the highest level range that starts at from and ends before to, or a single point:
+    int level = -1;
+    while (level+1 < mValueLevels.size() && from % (1<<(qcpValueLevelShift+level+1)) == 0 && from+(1<<(qcpValueLevelShift+level+1)) <= to)
+      ++level;
+    if (level < 0)
+    {
+      double value = mData.at(from).value;
+      qcpUniteValueRange(result, QCPRange(value, value));
+      ++from;
+    } else
+    {
+      qcpUniteValueRange(result, mValueLevels.at(level).at(from >> (qcpValueLevelShift+level)));
+      from += 1<<(qcpValueLevelShift+level);
+    }
   }
+  foundRange = !qIsNaN(result.lower);
+  return result;
 }
 
 /*!
-  \overload
-  Replaces the current data with the provided points in \a key and \a value pairs. Additionally the
-  negative value error of the data points are set to the values in \a valueErrorMinus, the positive
-  value error to \a valueErrorPlus.
-  For error bars to show appropriately, see \ref setErrorType.
-  The provided vectors should have equal length. Else, the number of added points will be the size of the
-  smallest vector.
+  Appends to \a points all data points with a key in \a keyRange and a value in \a valueRange
+  (bounds included), in ascending key order per value bin. Points with NaN value are never
+  returned.
+  
+  This is meant for hit-testing (see \ref QCPGraph::pointDistance): besides narrowing down by key,
+  it uses an index of the points binned by value, so only the bins overlapping \a valueRange are
+  searched. The index is built on the first call (O(n)) and then kept up to date
+  while points are appended or removed from the front; other changes drop it.
 */
-void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &valueErrorMinus, const QVector<double> &valueErrorPlus)
+void QCPDataContainer::pointsInRect(const QCPRange &keyRange, const QCPRange &valueRange, QVector<QCPData> *points) const
 {
-  mData->clear();
-  int n = key.size();
+  if (!points)
+    return;
+  if (!mValueBinsValid)
+    buildValueBins();
+  int binCount = mValueBins.size();
+  if (binCount == 0 || valueRange.upper < mValueBinLower || valueRange.lower > mValueBinUpper)
+    return;
+  int firstBin = qBound(0, int((valueRange.lower-mValueBinLower)/mValueBinWidth), binCount-1);
+  int lastBin = qBound(0, int((valueRange.upper-mValueBinLower)/mValueBinWidth), binCount-1);
+  for (int bin=firstBin; bin<=lastBin; ++bin)
+  {
+    const QVector<int> &indices = mValueBins.at(bin);
+    // skip points erased from the front, then the ones below the key range (both are in index order):
+    const int *it = std::lower_bound(indices.constBegin(), indices.constEnd(), mBegin);
+    int lo = it-indices.constBegin();
+    int hi = indices.size();
+    while (lo < hi)
+    {
+      int mid = (lo+hi)/2;
+      if (mData.at(indices.at(mid)).key < keyRange.lower)
+        lo = mid+1;
+      else
+        hi = mid;
+    }
+    for (int i=lo; i<indices.size(); ++i)
+    {
+      const QCPData &data = mData.at(indices.at(i));
+      if (data.key > keyRange.upper)
+        break;
+      if (data.value >= valueRange.lower && data.value <= valueRange.upper)
+        points->append(data);
+    }
+  }
+}
+
+/*! \fn QCPDataContainer::iterator QCPDataContainer::lowerBound(double key)
+  
+  Returns an iterator to the first data point with a key not smaller than \a key, or \ref end if
+  there is none.
+*/
+
+/*! \fn QCPDataContainer::iterator QCPDataContainer::upperBound(double key)
+  
+  Returns an iterator to the first data point with a key greater than \a key, or \ref end if
+  there is none.
+*/
+
+/*!
+  Returns an iterator to the first data point with exactly \a key, or \ref end if there is none.
+*/
+QCPDataContainer::iterator QCPDataContainer::find(double key)
+{
+  dropCaches();
+  int index = lowerIndex(key);
+  if (index < size() && mData.at(mBegin+index).key == key)
+    return iteratorAt(index);
+  return iteratorAt(size());
+}
+
+/*! \overload
+*/
+QCPDataContainer::const_iterator QCPDataContainer::constFind(double key) const
+{
+  const_iterator it = lowerBound(key);
+  if (it != constEnd() && it.key() == key)
+    return it;
+  return constEnd();
+}
+
+/*!
+  Reserves space for \a size data points. Like QVector::reserve, calling this repeatedly with
+  slowly growing sizes defeats the geometric growth of the vector.
+*/
+void QCPDataContainer::reserve(int size)
+{
+  compact();
+  mData.reserve(size);
+}
+
+/*!
+  Removes all data points.
+*/
+void QCPDataContainer::clear()
+{
+  mData.clear();
+  mBegin = 0;
+  mBoundsValid = true;
+  mBoundsFound = false;
+  mHasKeyErrors = false;
+  mHasValueErrors = false;
+  mValueBins.clear();
+  mValueLevels.clear();
+  dropIndexes();
+}
+
+/*!
+  Inserts \a data at \a key. If there already is a data point with this key, it is replaced (if
+  there are several, the last one is), like QMap::insert does.
+  
+  Changing the point through the returned iterator bypasses the cached bounds, insert the point
+  again instead.
+*/
+QCPDataContainer::iterator QCPDataContainer::insert(double key, const QCPData &data)
+{
+  int index = upperIndex(key);
+  if (index > 0 && mData.at(mBegin+index-1).key == key)
+  {
+    if (touchesBounds(mBegin+index-1, mBegin+index))
+      mBoundsValid = false;
+    dropIndexes();
+    QCPData &point = mData[mBegin+index-1];
+    point = data;
+    point.key = key;
+    includeInBounds(point);
+    return iteratorAt(index-1);
+  }
+  return insertMulti(key, data);
+}
+
+/*!
+  Inserts \a data at \a key, after any data points with the same key. Appending at the end (\a key
+  not smaller than the last key) is amortized O(1).
+  
+  Changing the point through the returned iterator bypasses the cached bounds, see \ref insert.
+*/
+QCPDataContainer::iterator QCPDataContainer::insertMulti(double key, const QCPData &data)
+{
+  int index = size();
+  if (isEmpty() || !(key < mData.last().key))
+  {
+    mData.append(data);
+  } else
+  {
+    index = upperIndex(key);
+    mData.insert(mBegin+index, data);
+    dropIndexes();
+  }
+  QCPData &point = mData[mBegin+index];
+  point.key = key;
+  includeInBounds(point);
+  addToValueBins(mBegin+index);
+  addToValueLevels(mBegin+index);
+  return iteratorAt(index);
+}
+
+/*!
+  Adds all data points of \a other. If \a other starts after the last key, its points are
+  appended, otherwise both ranges are merged.
+*/
+QCPDataContainer &QCPDataContainer::unite(const QCPDataContainer &other)
+{
+  if (other.isEmpty())
+    return *this;
+  if (isEmpty() || !(other.firstKey() < lastKey()))
+  {
+    for (const_iterator it = other.constBegin(); it != other.constEnd(); ++it)
+    {
+      mData.append(*it);
+      addToValueBins(mData.size()-1);
+      addToValueLevels(mData.size()-1);
+    }
+  } else
+  {
+    QVector<QCPData> merged(size()+other.size());
+    std::merge(constBegin().operator->(), constEnd().operator->(),
+               other.constBegin().operator->(), other.constEnd().operator->(),
+               merged.begin(), qcpLessThanSortKey);
+    mData.swap(merged);
+    mBegin = 0;
+    dropIndexes();
+  }
+  for (const_iterator it = other.constBegin(); it != other.constEnd(); ++it)
+    includeInBounds(*it);
+  return *this;
+}
+
+/*!
+  Removes the data point at \a it and returns an iterator to the following one.
+*/
+QCPDataContainer::iterator QCPDataContainer::erase(iterator it)
+{
+  return erase(it, it+1);
+}
+
+/*! \overload
+  
+  Removes the data points from \a first up to (excluding) \a last and returns an iterator to the
+  point that followed them. Erasing from the front is O(1) (amortized, see \ref compact).
+*/
+QCPDataContainer::iterator QCPDataContainer::erase(iterator first, iterator last)
+{
+  int from = first.p-mData.constData();
+  int to = last.p-mData.constData();
+  return iteratorAt(eraseIndices(from, to));
+}
+
+/*!
+  Removes all data points with exactly \a key and returns how many were removed.
+*/
+int QCPDataContainer::remove(double key)
+{
+  int from = mBegin+lowerIndex(key);
+  int to = mBegin+upperIndex(key);
+  eraseIndices(from, to);
+  return to-from;
+}
+
+/*!
+  Removes all data points with keys smaller than \a key.
+  
+  Unlike erasing an iterator range, this keeps the cached bounds unless a removed point lies on
+  them.
+*/
+void QCPDataContainer::removeBefore(double key)
+{
+  eraseIndices(mBegin, mBegin+lowerIndex(key));
+}
+
+/*!
+  Removes all data points with keys greater than \a key.
+  
+  \see removeBefore
+*/
+void QCPDataContainer::removeAfter(double key)
+{
+  eraseIndices(mBegin+upperIndex(key), mData.size());
+}
+
+/*!
+  Removes all data points with keys greater than \a fromKey and not greater than \a toKey.
+  
+  \see removeBefore
+*/
+void QCPDataContainer::removeBetween(double fromKey, double toKey)
+{
+  eraseIndices(mBegin+upperIndex(fromKey), mBegin+upperIndex(toKey));
+}
+
+/*! \internal
+  
+  Returns the index (relative to the first point) of the first point with a key not smaller than
+  \a key.
+*/
+int QCPDataContainer::lowerIndex(double key) const
+{
+  const QCPData *first = mData.constData()+mBegin;
+  return std::lower_bound(first, mData.constData()+mData.size(), key, qcpLessThanKey)-first;
+}
+
+/*! \internal
+  
+  Returns the index (relative to the first point) of the first point with a key greater than
+  \a key.
+*/
+int QCPDataContainer::upperIndex(double key) const
+{
+  const QCPData *first = mData.constData()+mBegin;
+  return std::upper_bound(first, mData.constData()+mData.size(), key, qcpKeyLessThan)-first;
+}
+
+/*! \internal
+  
+  Removes the points at the absolute indices \a from up to (excluding) \a to of \ref mData, and
+  returns the index (relative to the first point) of the point that followed them.
+*/
+int QCPDataContainer::eraseIndices(int from, int to)
+{
+  if (to <= from)
+    return from-mBegin;
+  if (touchesBounds(from, to))
+    mBoundsValid = false;
+  if (from == mBegin)
+  {
+    mBegin = to;
+    if (mBegin == mData.size())
+      mBoundsFound = false;
+    compact();
+    return 0;
+  }
+  mData.remove(from, to-from);
+  dropIndexes();
+  return from-mBegin;
+}
+
+/*! \internal
+  
+  Releases the space of points erased from the front once it makes up at least half of the
+  vector, so each erased point is moved at most once on average.
+*/
+void QCPDataContainer::compact()
+{
+  if (mBegin == mData.size())
+  {
+    mData.resize(0);
+    mBegin = 0;
+    dropIndexes();
+  } else if (mBegin > 0 && mBegin >= mData.size()/2)
+  {
+    mData.remove(0, mBegin);
+    mBegin = 0;
+    dropIndexes();
+  }
+}
+
+/*! \internal
+  
+  Widens the cached bounds (if valid) to include \a data.
+*/
+void QCPDataContainer::includeInBounds(const QCPData &data) const
+{
+  if (!mBoundsValid || qIsNaN(data.value))
+    return;
+  if (!mBoundsFound)
+  {
+    mValueLower = mValueUpper = data.value;
+    mValueErrorLower = data.value-data.valueErrorMinus;
+    mValueErrorUpper = data.value+data.valueErrorPlus;
+    mKeyErrorLower = data.key-data.keyErrorMinus;
+    mKeyErrorUpper = data.key+data.keyErrorPlus;
+    mHasKeyErrors = data.keyErrorMinus != 0 || data.keyErrorPlus != 0;
+    mHasValueErrors = data.valueErrorMinus != 0 || data.valueErrorPlus != 0;
+    mBoundsFound = true;
+    return;
+  }
+  // while no point has error bars, the error bounds aren't checked on removal and may be stale:
+  if (!mHasKeyErrors && (data.keyErrorMinus != 0 || data.keyErrorPlus != 0))
+  {
+    bool found;
+    QCPRange keys = plainKeyRange(found);
+    mKeyErrorLower = keys.lower;
+    mKeyErrorUpper = keys.upper;
+    mHasKeyErrors = true;
+  }
+  if (!mHasValueErrors && (data.valueErrorMinus != 0 || data.valueErrorPlus != 0))
+  {
+    mValueErrorLower = mValueLower;
+    mValueErrorUpper = mValueUpper;
+    mHasValueErrors = true;
+  }
+  mValueLower = qMin(mValueLower, data.value);
+  mValueUpper = qMax(mValueUpper, data.value);
+  mValueErrorLower = qMin(mValueErrorLower, data.value-data.valueErrorMinus);
+  mValueErrorUpper = qMax(mValueErrorUpper, data.value+data.valueErrorPlus);
+  mKeyErrorLower = qMin(mKeyErrorLower, data.key-data.keyErrorMinus);
+  mKeyErrorUpper = qMax(mKeyErrorUpper, data.key+data.keyErrorPlus);
+}
+
+/*! \internal
+  
+  Returns whether removing the points at the absolute indices \a from up to (excluding) \a to
+  would shrink the cached bounds.
+*/
+bool QCPDataContainer::touchesBounds(int from, int to) const
+{
+  if (!mBoundsValid || !mBoundsFound)
+    return false;
+  for (int i=from; i<to; ++i)
+  {
+    const QCPData &data = mData.at(i);
+    if (qIsNaN(data.value))
+      continue;
+    if (data.value <= mValueLower || data.value >= mValueUpper)
+      return true;
+    if (mHasValueErrors && (data.value-data.valueErrorMinus <= mValueErrorLower || data.value+data.valueErrorPlus >= mValueErrorUpper))
+      return true;
+    if (mHasKeyErrors && (data.key-data.keyErrorMinus <= mKeyErrorLower || data.key+data.keyErrorPlus >= mKeyErrorUpper))
+      return true;
+  }
+  return false;
+}
+
+/*! \internal
+  
+  Recalculates the cached bounds from all points, if they were dropped.
+*/
+void QCPDataContainer::updateBounds() const
+{
+  if (mBoundsValid)
+    return;
+  mBoundsValid = true;
+  mBoundsFound = false;
+  for (const_iterator it = constBegin(); it != constEnd(); ++it)
+    includeInBounds(*it);
+}
+
+/*! \internal
+  
+  Returns the range from the first to the last key of the points with non-NaN value.
+*/
+QCPRange QCPDataContainer::plainKeyRange(bool &foundRange) const
+{
+  const_iterator first = constBegin();
+  const_iterator last = constEnd();
+  while (first != last && qIsNaN(first->value))
+    ++first;
+  while (last != first && qIsNaN((last-1)->value))
+    --last;
+  foundRange = first != last;
+  if (!foundRange)
+    return QCPRange();
+  return QCPRange(first.key(), (last-1).key());
+}
+
+/*! \internal
+  
+  Builds the value-binned index used by \ref pointsInRect. The value range of the points is split
+  into about sqrt(n) equally wide bins (at most 1024), each holding the indices of its points in
+  key order.
+*/
+void QCPDataContainer::buildValueBins() const
+{
+  mValueBins.clear();
+  mValueBinsValid = true;
+  bool found;
+  QCPRange range = valueRange(found, false);
+  if (!found)
+    return;
+  int binCount = qBound(1, (int)qSqrt(size()), 1024);
+  mValueBinLower = range.lower;
+  mValueBinUpper = range.upper;
+  mValueBinWidth = range.size() > 0 ? range.size()/binCount : 1.0;
+  mValueBins.resize(binCount);
+  for (int i=mBegin; i<mData.size(); ++i)
+    addToValueBins(i);
+}
+
+/*! \internal
+  
+  Adds the point at \a index of \ref mData (which must be the last point) to the value-binned
+  index, if it is valid. If the value lies outside the binned range, the index is dropped.
+*/
+void QCPDataContainer::addToValueBins(int index) const
+{
+  if (!mValueBinsValid)
+    return;
+  double value = mData.at(index).value;
+  if (qIsNaN(value))
+    return;
+  if (mValueBins.isEmpty() || value < mValueBinLower || value > mValueBinUpper)
+  {
+    mValueBinsValid = false; // rebuilt with the new value range on the next query
+    return;
+  }
+  mValueBins[qBound(0, (int)((value-mValueBinLower)/mValueBinWidth), mValueBins.size()-1)].append(index);
+}
+
+/*! \internal
+  
+  Builds the min/max pyramid used by \ref valueRange(const_iterator, const_iterator, bool&) const.
+  It covers all of \ref mData, including points erased from the front (those ranges are never
+  used whole).
+*/
+void QCPDataContainer::buildValueLevels() const
+{
+  mValueLevels.clear();
+  mValueLevelsValid = true;
+  for (int i=0; i<mData.size(); ++i)
+    addToValueLevels(i);
+}
+
+/*! \internal
+  
+  Adds the point at \a index of \ref mData (which must be the last point) to the min/max pyramid,
+  if it is valid. This updates one range per level, and adds a level when the top one gets a second
+  range.
+*/
+void QCPDataContainer::addToValueLevels(int index) const
+{
+  if (!mValueLevelsValid)
+    return;
+  double value = mData.at(index).value;
+  QCPRange range(value, value);
+  if (mValueLevels.isEmpty())
+    mValueLevels.append(QVector<QCPRange>());
+  for (int level=0; level<mValueLevels.size(); ++level)
+  {
+    QVector<QCPRange> &ranges = mValueLevels[level];
+    int bucket = index >> (qcpValueLevelShift+level);
+    if (bucket == ranges.size())
+      ranges.append(range);
+    else
+      qcpUniteValueRange(ranges[bucket], range);
+    if (level == mValueLevels.size()-1 && ranges.size() > 1)
+    {
+      // top level got a second range, add a level above it that pairs up its ranges:
+      QVector<QCPRange> above((ranges.size()+1)/2, range);
+      for (int i=0; i<ranges.size(); ++i)
+      {
+        if (i % 2 == 0)
+          above[i/2] = ranges.at(i);
+        else
+          qcpUniteValueRange(above[i/2], ranges.at(i));
+      }
+      mValueLevels.append(above);
+      break;
+    }
+  }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//////////////////// QCPGraph
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/*! \class QCPGraph
+  \brief A plottable representing a graph in a plot.
+
+  \image html QCPGraph.png
+  
+  Usually you create new graphs by calling QCustomPlot::addGraph. The resulting instance can be
+  accessed via QCustomPlot::graph.
+
+  To plot data, assign it with the \ref setData or \ref addData functions. Alternatively, you can
+  also access and modify the graph's data via the \ref data method, which returns a pointer to the
+  internal \ref QCPDataMap.
+  
+  Graphs are used to display single-valued data. Single-valued means that there should only be one
+  data point per unique key coordinate. In other words, the graph can't have \a loops. If you do
+  want to plot non-single-valued curves, rather use the QCPCurve plottable.
+  
+  Gaps in the graph line can be created by adding data points with NaN as value
+  (<tt>qQNaN()</tt> or <tt>std::numeric_limits<double>::quiet_NaN()</tt>) in between the two data points that shall be
+  separated.
+  
+  \section appearance Changing the appearance
+  
+  The appearance of the graph is mainly determined by the line style, scatter style, brush and pen
+  of the graph (\ref setLineStyle, \ref setScatterStyle, \ref setBrush, \ref setPen).
+  
+  \subsection filling Filling under or between graphs
+  
+  QCPGraph knows two types of fills: Normal graph fills towards the zero-value-line parallel to
+  the key axis of the graph, and fills between two graphs, called channel fills. To enable a fill,
+  just set a brush with \ref setBrush which is neither Qt::NoBrush nor fully transparent.
+  
+  By default, a normal fill towards the zero-value-line will be drawn. To set up a channel fill
+  between this graph and another one, call \ref setChannelFillGraph with the other graph as
+  parameter.
+
+  \see QCustomPlot::addGraph, QCustomPlot::graph
+*/
+
+/* start of documentation of inline functions */
+
+/*! \fn QCPDataMap *QCPGraph::data() const
+  
+  Returns a pointer to the internal data storage of type \ref QCPDataMap. You may use it to
+  directly manipulate the data, which may be more convenient and faster than using the regular \ref
+  setData or \ref addData methods, in certain situations.
+*/
+
+/* end of documentation of inline functions */
+
+/*!
+  Constructs a graph which uses \a keyAxis as its key axis ("x") and \a valueAxis as its value
+  axis ("y"). \a keyAxis and \a valueAxis must reside in the same QCustomPlot instance and not have
+  the same orientation. If either of these restrictions is violated, a corresponding message is
+  printed to the debug output (qDebug), the construction is not aborted, though.
+  
+  The constructed QCPGraph can be added to the plot with QCustomPlot::addPlottable, QCustomPlot
+  then takes ownership of the graph.
+  
+  To directly create a graph inside a plot, you can also use the simpler QCustomPlot::addGraph function.
+*/
+QCPGraph::QCPGraph(QCPAxis *keyAxis, QCPAxis *valueAxis) :
+  QCPAbstractPlottable(keyAxis, valueAxis)
+{
+  mData = new QCPDataMap;
+  
+  setPen(QPen(Qt::blue, 0));
+  setErrorPen(QPen(Qt::black));
+  setBrush(Qt::NoBrush);
+  setSelectedPen(QPen(QColor(80, 80, 255), 2.5));
+  setSelectedBrush(Qt::NoBrush);
+  
+  setLineStyle(lsLine);
+  setErrorType(etNone);
+  setErrorBarSize(6);
+  setErrorBarSkipSymbol(true);
+  setChannelFillGraph(0);
+  setAdaptiveSampling(true);
+}
+
+QCPGraph::~QCPGraph()
+{
+  delete mData;
+}
+
+/*!
+  Replaces the current data with the provided \a data.
+  
+  If \a copy is set to true, data points in \a data will only be copied. if false, the graph
+  takes ownership of the passed data and replaces the internal data pointer with it. This is
+  significantly faster than copying for large datasets.
+  
+  Alternatively, you can also access and modify the graph's data via the \ref data method, which
+  returns a pointer to the internal \ref QCPDataMap.
+*/
+void QCPGraph::setData(QCPDataMap *data, bool copy)
+{
+  if (mData == data)
+  {
+    qDebug() << Q_FUNC_INFO << "The data pointer is already in (and owned by) this plottable" << reinterpret_cast<quintptr>(data);
+    return;
+  }
+  if (copy)
+  {
+    *mData = *data;
+  } else
+  {
+    delete mData;
+    mData = data;
+  }
+}
+
+/*! \overload
+  
+  Replaces the current data with the provided points in \a key and \a value pairs. The provided
+  vectors should have equal length. Else, the number of added points will be the size of the
+  smallest vector.
+*/
+void QCPGraph::setData(const QVector<double> &key, const QVector<double> &value)
+{
+  mData->clear();
+  int n = key.size();
+  n = qMin(n, value.size());
+  mData->reserve(n); // the container was just cleared, this is the only allocation
+  QCPData newData;
+  for (int i=0; i<n; ++i)
+  {
+    newData.key = key[i];
+    newData.value = value[i];
+    mData->insertMulti(newData.key, newData);
+  }
+}
+
+/*!
+  Replaces the current data with the provided points in \a key and \a value pairs. Additionally the
+  symmetrical value error of the data points are set to the values in \a valueError.
+  For error bars to show appropriately, see \ref setErrorType.
+  The provided vectors should have equal length. Else, the number of added points will be the size of the
+  smallest vector.
+  
+  For asymmetrical errors (plus different from minus), see the overloaded version of this function.
+*/
+void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &valueError)
+{
+  mData->clear();
+  int n = key.size();
+  n = qMin(n, value.size());
+  n = qMin(n, valueError.size());
+  QCPData newData;
+  for (int i=0; i<n; ++i)
+  {
+    newData.key = key[i];
+    newData.value = value[i];
+    newData.valueErrorMinus = valueError[i];
+    newData.valueErrorPlus = valueError[i];
+    mData->insertMulti(key[i], newData);
+  }
+}
+
+/*!
+  \overload
+  Replaces the current data with the provided points in \a key and \a value pairs. Additionally the
+  negative value error of the data points are set to the values in \a valueErrorMinus, the positive
+  value error to \a valueErrorPlus.
+  For error bars to show appropriately, see \ref setErrorType.
+  The provided vectors should have equal length. Else, the number of added points will be the size of the
+  smallest vector.
+*/
+void QCPGraph::setDataValueError(const QVector<double> &key, const QVector<double> &value, const QVector<double> &valueErrorMinus, const QVector<double> &valueErrorPlus)
+{
+  mData->clear();
+  int n = key.size();
   n = qMin(n, value.size());
   n = qMin(n, valueErrorMinus.size());
   n = qMin(n, valueErrorPlus.size());
@@ -14903,6 +16237,8 @@ void QCPGraph::addData(double key, double value)
 */
 void QCPGraph::addData(const QVector<double> &keys, const QVector<double> &values)
 {
+  // no reserve here: with repeated small batches an exact reserve would reallocate on every
+  // call, appending lets the vector grow geometrically
   int n = qMin(keys.size(), values.size());
   QCPData newData;
   for (int i=0; i<n; ++i)
@@ -14919,9 +16255,7 @@ void QCPGraph::addData(const QVector<double> &keys, const QVector<double> &value
 */
 void QCPGraph::removeDataBefore(double key)
 {
-  QCPDataMap::iterator it = mData->begin();
-  while (it != mData->end() && it.key() < key)
-    it = mData->erase(it);
+  mData->removeBefore(key);
 }
 
 /*!
@@ -14931,9 +16265,7 @@ void QCPGraph::removeDataBefore(double key)
 void QCPGraph::removeDataAfter(double key)
 {
   if (mData->isEmpty()) return;
-  QCPDataMap::iterator it = mData->upperBound(key);
-  while (it != mData->end())
-    it = mData->erase(it);
+  mData->removeAfter(key);
 }
 
 /*!
@@ -14946,10 +16278,7 @@ void QCPGraph::removeDataAfter(double key)
 void QCPGraph::removeData(double fromKey, double toKey)
 {
   if (fromKey >= toKey || mData->isEmpty()) return;
-  QCPDataMap::iterator it = mData->upperBound(fromKey);
-  QCPDataMap::iterator itEnd = mData->upperBound(toKey);
-  while (it != itEnd)
-    it = mData->erase(it);
+  mData->removeBetween(fromKey, toKey);
 }
 
 /*! \overload
@@ -15535,7 +16864,37 @@ void QCPGraph::drawScatterPlot(QCPPainter *painter, QVector<QCPData> *scatterDat
   // draw scatter point symbols:
   applyScattersAntialiasingHint(painter);
   mScatterStyle.applyTo(painter, mPen);
-  if (keyAxis->orientation() == Qt::Vertical)
+  if (updateScatterSprite(painter))
+  {
+    // blit the pre-rendered symbol at whole pixels, skipping points on a pixel that already got a
+    // symbol (dense data hits the same pixels many times). Visited pixels are kept in a bitmap of
+    // the clip rect, points outside of it are always drawn because their symbols may reach into it:
+    QPointF deviceOffset(painter->transform().dx(), painter->transform().dy());
+    QPointF subPixel(deviceOffset.x()-qFloor(deviceOffset.x()), deviceOffset.y()-qFloor(deviceOffset.y())); // e.g. the half pixel shift of QCPPainter::setAntialiasing
+    int radius = mScatterSprite.width()/2;
+    QRect area = clipRect();
+    QBitArray visited(area.width()*area.height());
+    for (int i=0; i<scatterData->size(); ++i)
+    {
+      if (qIsNaN(scatterData->at(i).value))
+        continue;
+      double keyPixel = keyAxis->coordToPixel(scatterData->at(i).key);
+      double valuePixel = valueAxis->coordToPixel(scatterData->at(i).value);
+      QPointF pos = keyAxis->orientation() == Qt::Vertical ? QPointF(valuePixel, keyPixel) : QPointF(keyPixel, valuePixel);
+      QPoint pixel = pos.toPoint();
+      if (area.contains(pixel))
+      {
+        int bit = (pixel.y()-area.top())*area.width() + pixel.x()-area.left();
+        if (visited.testBit(bit))
+          continue;
+        visited.setBit(bit);
+      }
+      // the sprite already contains the sub pixel shift (it is rendered with the same antialiasing
+      // as painter), so the shift is only taken out of the pixmap origin, which then falls on a
+      // whole device pixel:
+      painter->drawPixmap(QPointF(pixel.x()-radius, pixel.y()-radius)-subPixel, mScatterSprite);
+    }
+  } else if (keyAxis->orientation() == Qt::Vertical)
   {
     for (int i=0; i<scatterData->size(); ++i)
       if (!qIsNaN(scatterData->at(i).value))
@@ -15548,6 +16907,63 @@ void QCPGraph::drawScatterPlot(QCPPainter *painter, QVector<QCPData> *scatterDat
   }
 }
 
+/*! \internal
+  
+  Makes sure mScatterSprite holds the scatter symbol of this graph, rendered with the pen, brush and
+  antialiasing currently set on \a painter (see \ref QCPScatterStyle::applyTo). The sprite is only
+  rendered again when one of those or the scatter shape or size has changed, which is tracked with
+  mScatterSpriteKey.
+  
+  Returns false if the symbols must be drawn with \ref QCPScatterStyle::drawShape instead: when the
+  painter doesn't allow caching (exports, see \ref QCPPainter::pmNoCaching) or is scaled or rotated,
+  for \ref QCPScatterStyle::ssPixmap and \ref QCPScatterStyle::ssCustom shapes, and for pens and
+  brushes that aren't a solid color.
+  
+  \see drawScatterPlot
+*/
+bool QCPGraph::updateScatterSprite(QCPPainter *painter) const
+{
+  if (painter->modes().testFlag(QCPPainter::pmNoCaching) || painter->modes().testFlag(QCPPainter::pmVectorized))
+    return false;
+  if (painter->transform().type() > QTransform::TxTranslate)
+    return false;
+  QCPScatterStyle::ScatterShape shape = mScatterStyle.shape();
+  if (shape == QCPScatterStyle::ssNone || shape == QCPScatterStyle::ssPixmap || shape == QCPScatterStyle::ssCustom)
+    return false;
+  QPen pen = painter->pen();
+  QBrush brush = painter->brush();
+  if (pen.brush().style() != Qt::SolidPattern || (brush.style() != Qt::NoBrush && brush.style() != Qt::SolidPattern))
+    return false;
+  
+  QByteArray key;
+  key.append(QByteArray::number((int)shape)+';');
+  key.append(QByteArray::number(mScatterStyle.size())+';');
+  key.append(QByteArray::number(pen.color().rgba(), 16)+';');
+  key.append(QByteArray::number(pen.widthF())+';');
+  key.append(QByteArray::number((int)pen.style())+';');
+  key.append(QByteArray::number((int)pen.capStyle())+';');
+  key.append(QByteArray::number((int)pen.joinStyle())+';');
+  key.append(QByteArray::number((int)brush.style())+';');
+  key.append(QByteArray::number(brush.color().rgba(), 16)+';');
+  key.append(QByteArray::number((int)painter->antialiasing()));
+  if (key == mScatterSpriteKey && !mScatterSprite.isNull())
+    return true;
+  
+  // the symbol is drawn at the whole pixel coordinate (radius, radius) of the sprite, plus the same
+  // half pixel shift as on painter, like a symbol drawn directly at a whole pixel coordinate:
+  int radius = qCeil(mScatterStyle.size()/2.0 + qMax(1.0, pen.widthF())/2.0) + 1;
+  mScatterSprite = QPixmap(2*radius, 2*radius);
+  mScatterSprite.fill(Qt::transparent);
+  QCPPainter spritePainter(&mScatterSprite);
+  spritePainter.setAntialiasing(painter->antialiasing()); // also applies the same half pixel shift as on painter
+  spritePainter.setPen(pen);
+  spritePainter.setBrush(brush);
+  mScatterStyle.drawShape(&spritePainter, radius, radius);
+  spritePainter.end();
+  mScatterSpriteKey = key;
+  return true;
+}
+
 /*!  \internal
   
   Draws line graphs from the provided data. It connects all points in \a lineData, which was
@@ -15682,60 +17098,48 @@ void QCPGraph::getPreparedData(QVector<QCPData> *lineData, QVector<QCPData> *sca
   {
     if (lineData)
     {
+      // step through the pixel intervals instead of the points: the points of an interval are found by
+      // binary search and their value span is read from the min/max pyramid of the data container,
+      // so this is O(pixels) rather than O(points):
+      const QCPDataMap *data = mData;
       QCPDataMap::const_iterator it = lower;
       QCPDataMap::const_iterator upperEnd = upper+1;
-      double minValue = it.value().value;
-      double maxValue = it.value().value;
-      QCPDataMap::const_iterator currentIntervalFirstPoint = it;
       int reversedFactor = keyAxis->rangeReversed() != (keyAxis->orientation()==Qt::Vertical) ? -1 : 1; // is used to calculate keyEpsilon pixel into the correct direction
       int reversedRound = keyAxis->rangeReversed() != (keyAxis->orientation()==Qt::Vertical) ? 1 : 0; // is used to switch between floor (normal) and ceil (reversed) rounding of currentIntervalStartKey
       double currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(lower.key())+reversedRound));
       double lastIntervalEndKey = currentIntervalStartKey;
       double keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor)); // interval of one pixel on screen when mapped to plot key coordinates
       bool keyEpsilonVariable = keyAxis->scaleType() == QCPAxis::stLogarithmic; // indicates whether keyEpsilon needs to be updated after every interval (for log axes)
-      int intervalDataCount = 1;
-      ++it; // advance iterator to second data point because adaptive sampling works in 1 point retrospect
       while (it != upperEnd)
       {
-        if (it.key() < currentIntervalStartKey+keyEpsilon) // data point is still within same pixel, so skip it and expand value span of this cluster if necessary
+        QCPDataMap::const_iterator intervalEnd = data->lowerBound(currentIntervalStartKey+keyEpsilon); // first data point of the next pixel
+        if (upperEnd < intervalEnd)
+          intervalEnd = upperEnd;
+        if (!(it < intervalEnd)) // in case of rounding issues, the interval contains at least its first point
+          intervalEnd = it+1;
+        if (intervalEnd-it >= 2) // pixel has multiple data points, consolidate them to a cluster
         {
-          if (it.value().value < minValue)
-            minValue = it.value().value;
-          else if (it.value().value > maxValue)
-            maxValue = it.value().value;
-          ++intervalDataCount;
-        } else // new pixel interval started
+          bool foundRange;
+          QCPRange valueSpan = data->valueRange(it, intervalEnd, foundRange);
+          if (!foundRange)
+            valueSpan = QCPRange(it.value().value, it.value().value);
+          if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
+            lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.2, it.value().value));
+          lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.25, valueSpan.lower));
+          lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.75, valueSpan.upper));
+          if (intervalEnd != upperEnd && intervalEnd.key() > currentIntervalStartKey+keyEpsilon*2) // new pixel starts further away from this cluster, so make sure the last point of the cluster is at a real data point
+            lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.8, (intervalEnd-1).value().value));
+        } else
+          lineData->append(QCPData(it.key(), it.value().value));
+        lastIntervalEndKey = (intervalEnd-1).key();
+        it = intervalEnd;
+        if (it != upperEnd)
         {
-          if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
-          {
-            if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point is further away, so first point of this cluster must be at a real data point
-              lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint.value().value));
-            lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
-            lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
-            if (it.key() > currentIntervalStartKey+keyEpsilon*2) // new pixel started further away from previous cluster, so make sure the last point of the cluster is at a real data point
-              lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.8, (it-1).value().value));
-          } else
-            lineData->append(QCPData(currentIntervalFirstPoint.key(), currentIntervalFirstPoint.value().value));
-          lastIntervalEndKey = (it-1).value().key;
-          minValue = it.value().value;
-          maxValue = it.value().value;
-          currentIntervalFirstPoint = it;
           currentIntervalStartKey = keyAxis->pixelToCoord((int)(keyAxis->coordToPixel(it.key())+reversedRound));
           if (keyEpsilonVariable)
             keyEpsilon = qAbs(currentIntervalStartKey-keyAxis->pixelToCoord(keyAxis->coordToPixel(currentIntervalStartKey)+1.0*reversedFactor));
-          intervalDataCount = 1;
         }
-        ++it;
       }
-      // handle last interval:
-      if (intervalDataCount >= 2) // last pixel had multiple data points, consolidate them to a cluster
-      {
-        if (lastIntervalEndKey < currentIntervalStartKey-keyEpsilon) // last point wasn't a cluster, so first point of this cluster must be at a real data point
-          lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.2, currentIntervalFirstPoint.value().value));
-        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.25, minValue));
-        lineData->append(QCPData(currentIntervalStartKey+keyEpsilon*0.75, maxValue));
-      } else
-        lineData->append(QCPData(currentIntervalFirstPoint.key(), currentIntervalFirstPoint.value().value));
     }
     
     if (scatterData)
@@ -15967,9 +17371,10 @@ void QCPGraph::getVisibleDataBounds(QCPDataMap::const_iterator &lower, QCPDataMa
     return;
   }
   
-  // get visible data range as QMap iterators
-  QCPDataMap::const_iterator lbound = mData->lowerBound(mKeyAxis.data()->range().lower);
-  QCPDataMap::const_iterator ubound = mData->upperBound(mKeyAxis.data()->range().upper);
+  // get visible data range as QMap iterators (const access, so the cached data bounds are kept)
+  const QCPDataMap *data = mData;
+  QCPDataMap::const_iterator lbound = data->lowerBound(mKeyAxis.data()->range().lower);
+  QCPDataMap::const_iterator ubound = data->upperBound(mKeyAxis.data()->range().upper);
   bool lowoutlier = lbound != mData->constBegin(); // indicates whether there exist points below axis range
   bool highoutlier = ubound != mData->constEnd(); // indicates whether there exist points above axis range
   
@@ -15991,14 +17396,7 @@ int QCPGraph::countDataInBounds(const QCPDataMap::const_iterator &lower, const Q
 {
   if (upper == mData->constEnd() && lower == mData->constEnd())
     return 0;
-  QCPDataMap::const_iterator it = lower;
-  int count = 1;
-  while (it != upper && count < maxCount)
-  {
-    ++it;
-    ++count;
-  }
-  return count;
+  return qMin(upper-lower+1, maxCount); // the data is contiguous, so this doesn't need to walk the points
 }
 
 /*! \internal
@@ -16394,8 +17792,15 @@ int QCPGraph::findIndexAboveY(const QVector<QPointF> *data, double y) const
   pixelPoint in pixels. This is used to determine whether the graph was clicked or not, e.g. in
   \ref selectTest.
   
+  Only data within the selection tolerance (\ref QCustomPlot::setSelectionTolerance) around \a
+  pixelPoint can be closer than the tolerance, so the data is first narrowed down to that
+  neighbourhood: by key for lines (binary search in the sorted data), and additionally by value for
+  scatter-only graphs (see \ref QCPDataContainer::pointsInRect). This keeps hit-testing fast for
+  any data size. The returned distance is exact if it is below the tolerance.
+  
   If either the graph has no data or if the line style is \ref lsNone and the scatter style's shape
   is \ref QCPScatterStyle::ssNone (i.e. there is no visual representation of the graph), returns -1.0.
+  It also returns -1.0 if no part of the graph is in the neighbourhood of \a pixelPoint.
 */
 double QCPGraph::pointDistance(const QPointF &pixelPoint) const
 {
@@ -16403,13 +17808,25 @@ double QCPGraph::pointDistance(const QPointF &pixelPoint) const
     return -1.0;
   if (mLineStyle == lsNone && mScatterStyle.isNone())
     return -1.0;
+  QCPAxis *keyAxis = mKeyAxis.data();
+  QCPAxis *valueAxis = mValueAxis.data();
+  if (!keyAxis || !valueAxis) { qDebug() << Q_FUNC_INFO << "invalid key or value axis"; return -1.0; }
+  
+  // data coordinate ranges of the tolerance neighbourhood:
+  double tolerance = mParentPlot->selectionTolerance();
+  double keyPixel = keyAxis->orientation() == Qt::Horizontal ? pixelPoint.x() : pixelPoint.y();
+  double valuePixel = keyAxis->orientation() == Qt::Horizontal ? pixelPoint.y() : pixelPoint.x();
+  QCPRange keyRange(keyAxis->pixelToCoord(keyPixel-tolerance), keyAxis->pixelToCoord(keyPixel+tolerance));
+  keyRange.normalize();
   
   // calculate minimum distances to graph representation:
   if (mLineStyle == lsNone)
   {
     // no line displayed, only calculate distance to scatter points:
+    QCPRange valueRange(valueAxis->pixelToCoord(valuePixel-tolerance), valueAxis->pixelToCoord(valuePixel+tolerance));
+    valueRange.normalize();
     QVector<QCPData> scatterData;
-    getScatterPlotData(&scatterData);
+    mData->pointsInRect(keyRange, valueRange, &scatterData);
     if (scatterData.size() > 0)
     {
       double minDistSqr = std::numeric_limits<double>::max();
@@ -16420,13 +17837,13 @@ double QCPGraph::pointDistance(const QPointF &pixelPoint) const
           minDistSqr = currentDistSqr;
       }
       return qSqrt(minDistSqr);
-    } else // no data available in view to calculate distance to
+    } else // no data in the neighbourhood to calculate distance to
       return -1.0;
   } else
   {
-    // line displayed, calculate distance to line segments:
+    // line displayed, calculate distance to the line segments that reach into the neighbourhood:
     QVector<QPointF> lineData;
-    getPlotData(&lineData, 0); // unlike with getScatterPlotData we get pixel coordinates here
+    getNeighbourhoodLineData(keyRange, &lineData);
     if (lineData.size() > 1) // at least one line segment, compare distance to line segments
     {
       double minDistSqr = std::numeric_limits<double>::max();
@@ -16453,11 +17870,100 @@ double QCPGraph::pointDistance(const QPointF &pixelPoint) const
     } else if (lineData.size() > 0) // only single data point, calculate distance to that point
     {
       return QVector2D(lineData.at(0)-pixelPoint).length();
-    } else // no data available in view to calculate distance to
+    } else // no data in the neighbourhood to calculate distance to
       return -1.0;
   }
 }
 
+/*! \internal
+  
+  Returns in \a linePixelData the pixel coordinates of the graph line (like \ref getPlotData does
+  for the current line style) for the data in \a keyRange, plus one data point on either side, so
+  all line segments reaching into \a keyRange are included. Unlike \ref getPlotData, the data is
+  not adaptively sampled.
+  
+  This is used by \ref pointDistance.
+*/
+void QCPGraph::getNeighbourhoodLineData(const QCPRange &keyRange, QVector<QPointF> *linePixelData) const
+{
+  const QCPDataMap *data = mData;
+  QCPDataMap::const_iterator it = data->lowerBound(keyRange.lower);
+  QCPDataMap::const_iterator itEnd = data->upperBound(keyRange.upper);
+  if (it != data->constBegin())
+    --it;
+  if (itEnd != data->constEnd())
+    ++itEnd;
+  if (it == itEnd)
+    return;
+  
+  bool keyHorizontal = mKeyAxis.data()->orientation() == Qt::Horizontal;
+  linePixelData->reserve((itEnd-it)*2);
+  QPointF last = coordsToPixels(it.key(), it.value().value);
+  switch (mLineStyle)
+  {
+    case lsNone: break;
+    case lsLine:
+    {
+      for (; it != itEnd; ++it)
+        linePixelData->append(coordsToPixels(it.key(), it.value().value));
+      break;
+    }
+    case lsStepLeft:
+    {
+      double lastValue = it.value().value;
+      for (; it != itEnd; ++it)
+      {
+        linePixelData->append(coordsToPixels(it.key(), lastValue));
+        lastValue = it.value().value;
+        linePixelData->append(coordsToPixels(it.key(), lastValue));
+      }
+      break;
+    }
+    case lsStepRight:
+    {
+      double lastKey = it.key();
+      for (; it != itEnd; ++it)
+      {
+        linePixelData->append(coordsToPixels(lastKey, it.value().value));
+        lastKey = it.key();
+        linePixelData->append(coordsToPixels(lastKey, it.value().value));
+      }
+      break;
+    }
+    case lsStepCenter:
+    {
+      // steps are centered between the data points in pixel coordinates:
+      linePixelData->append(last);
+      for (++it; it != itEnd; ++it)
+      {
+        QPointF current = coordsToPixels(it.key(), it.value().value);
+        QPointF center = (last+current)*0.5;
+        if (keyHorizontal)
+        {
+          linePixelData->append(QPointF(center.x(), last.y()));
+          linePixelData->append(QPointF(center.x(), current.y()));
+        } else
+        {
+          linePixelData->append(QPointF(last.x(), center.y()));
+          linePixelData->append(QPointF(current.x(), center.y()));
+        }
+        last = current;
+      }
+      linePixelData->append(last);
+      break;
+    }
+    case lsImpulse:
+    {
+      for (; it != itEnd; ++it)
+      {
+        linePixelData->append(coordsToPixels(it.key(), 0));
+        linePixelData->append(coordsToPixels(it.key(), it.value().value));
+      }
+      break;
+    }
+  }
+}
+
 /*! \internal
   
   Finds the highest index of \a data, whose points y value is just below \a y. Assumes y values in
@@ -16505,36 +18011,16 @@ QCPRange QCPGraph::getValueRange(bool &foundRange, SignDomain inSignDomain) cons
 */
 QCPRange QCPGraph::getKeyRange(bool &foundRange, SignDomain inSignDomain, bool includeErrors) const
 {
+  if (inSignDomain == sdBoth) // range may be anywhere, the data container keeps track of it
+    return mData->keyRange(foundRange, includeErrors);
+  
   QCPRange range;
   bool haveLower = false;
   bool haveUpper = false;
   
   double current, currentErrorMinus, currentErrorPlus;
   
-  if (inSignDomain == sdBoth) // range may be anywhere
-  {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
-    {
-      if (!qIsNaN(it.value().value))
-      {
-        current = it.value().key;
-        currentErrorMinus = (includeErrors ? it.value().keyErrorMinus : 0);
-        currentErrorPlus = (includeErrors ? it.value().keyErrorPlus : 0);
-        if (current-currentErrorMinus < range.lower || !haveLower)
-        {
-          range.lower = current-currentErrorMinus;
-          haveLower = true;
-        }
-        if (current+currentErrorPlus > range.upper || !haveUpper)
-        {
-          range.upper = current+currentErrorPlus;
-          haveUpper = true;
-        }
-      }
-      ++it;
-    }
-  } else if (inSignDomain == sdNegative) // range may only be in the negative sign domain
+  if (inSignDomain == sdNegative) // range may only be in the negative sign domain
   {
     QCPDataMap::const_iterator it = mData->constBegin();
     while (it != mData->constEnd())
@@ -16620,36 +18106,16 @@ QCPRange QCPGraph::getKeyRange(bool &foundRange, SignDomain inSignDomain, bool i
 */
 QCPRange QCPGraph::getValueRange(bool &foundRange, SignDomain inSignDomain, bool includeErrors) const
 {
+  if (inSignDomain == sdBoth) // range may be anywhere, the data container keeps track of it
+    return mData->valueRange(foundRange, includeErrors);
+  
   QCPRange range;
   bool haveLower = false;
   bool haveUpper = false;
   
   double current, currentErrorMinus, currentErrorPlus;
   
-  if (inSignDomain == sdBoth) // range may be anywhere
-  {
-    QCPDataMap::const_iterator it = mData->constBegin();
-    while (it != mData->constEnd())
-    {
-      current = it.value().value;
-      if (!qIsNaN(current))
-      {
-        currentErrorMinus = (includeErrors ? it.value().valueErrorMinus : 0);
-        currentErrorPlus = (includeErrors ? it.value().valueErrorPlus : 0);
-        if (current-currentErrorMinus < range.lower || !haveLower)
-        {
-          range.lower = current-currentErrorMinus;
-          haveLower = true;
-        }
-        if (current+currentErrorPlus > range.upper || !haveUpper)
-        {
-          range.upper = current+currentErrorPlus;
-          haveUpper = true;
-        }
-      }
-      ++it;
-    }
-  } else if (inSignDomain == sdNegative) // range may only be in the negative sign domain
+  if (inSignDomain == sdNegative) // range may only be in the negative sign domain
   {
     QCPDataMap::const_iterator it = mData->constBegin();
     while (it != mData->constEnd())
@@ -23262,7 +24728,8 @@ void QCPItemTracer::updatePosition()
           position->setCoords(last.key(), last.value().value);
         else
         {
-          QCPDataMap::const_iterator it = mGraph->data()->lowerBound(mGraphKey);
+          const QCPDataMap *data = mGraph->data();
+          QCPDataMap::const_iterator it = data->lowerBound(mGraphKey);
           if (it != first) // mGraphKey is somewhere between iterators
           {
             QCPDataMap::const_iterator prevIt = it-1;
@@ -42,9 +42,15 @@
 #include <QVector2D>
 #include <QStack>
 #include <QCache>
+#include <QHash>
 #include <QMargins>
+#include <QImage>
+#include <QPicture>
+#include <QRunnable>
+#include <QThreadPool>
 #include <qmath.h>
 #include <limits>
+#include <algorithm>
 #if QT_VERSION < QT_VERSION_CHECK(5, 0, 0)
 #  include <qnumeric.h>
 #  include <QPrinter>
@@ -371,8 +377,19 @@ class QCP_LIB_DECL QCPLayer : public QObject
   Q_PROPERTY(int index READ index)
   Q_PROPERTY(QList<QCPLayerable*> children READ children)
   Q_PROPERTY(bool visible READ visible WRITE setVisible)
+  Q_PROPERTY(LayerMode mode READ mode WRITE setMode)
   /// \endcond
 public:
+  /*!
+    Defines how a layer is rendered on a \ref QCustomPlot::replot.
+    
+    \see setMode
+  */
+  enum LayerMode { lmLogical   ///< Layerables are drawn directly into the plot's paint buffer on every replot
+                   ,lmBuffered ///< The layer keeps its own paint buffer which is only redrawn when the layer was marked dirty (\ref markDirty)
+                 };
+  Q_ENUMS(LayerMode)
+  
   QCPLayer(QCustomPlot* parentPlot, const QString &layerName);
   ~QCPLayer();
   
@@ -382,9 +399,17 @@ public:
   int index() const { return mIndex; }
   QList<QCPLayerable*> children() const { return mChildren; }
   bool visible() const { return mVisible; }
+  LayerMode mode() const { return mMode; }
+  QCPAxis *scrollAxis() const { return mScrollAxis.data(); }
   
   // setters:
   void setVisible(bool visible);
+  void setMode(LayerMode mode);
+  void setScrollAxis(QCPAxis *axis);
+  
+  // non-property methods:
+  void markDirty();
+  void markDirtyFrom(double key, int pixelMargin=8);
   
 protected:
   // property members:
@@ -393,8 +418,22 @@ protected:
   int mIndex;
   QList<QCPLayerable*> mChildren;
   bool mVisible;
+  LayerMode mMode;
+  QPointer<QCPAxis> mScrollAxis;
+  
+  // non-property members:
+  QPixmap mBuffer;
+  bool mBufferDirty;
+  double mScrollLower, mScrollUpper; // scroll axis range the buffer was drawn with
+  double mScrollResidual;
+  double mScrollDirtyKey;
+  int mScrollDirtyMargin;
   
   // non-virtual methods:
+  void draw(QCPPainter *painter);
+  void drawBuffered(QCPPainter *painter);
+  bool scrollBuffer(QCPAxis *axis, QRegion *exposed);
+  void axisRangeChanged(QCPAxis *axis);
   void addChild(QCPLayerable *layerable, bool prepend);
   void removeChild(QCPLayerable *layerable);
   
@@ -1000,6 +1039,7 @@ class QCP_LIB_DECL QCPAxis : public QCPLayerable
   Q_PROPERTY(QColor tickLabelColor READ tickLabelColor WRITE setTickLabelColor)
   Q_PROPERTY(double tickLabelRotation READ tickLabelRotation WRITE setTickLabelRotation)
   Q_PROPERTY(LabelSide tickLabelSide READ tickLabelSide WRITE setTickLabelSide)
+  Q_PROPERTY(int tickLabelCacheBudget READ tickLabelCacheBudget WRITE setTickLabelCacheBudget)
   Q_PROPERTY(QString dateTimeFormat READ dateTimeFormat WRITE setDateTimeFormat)
   Q_PROPERTY(Qt::TimeSpec dateTimeSpec READ dateTimeSpec WRITE setDateTimeSpec)
   Q_PROPERTY(QString numberFormat READ numberFormat WRITE setNumberFormat)
@@ -1108,6 +1148,9 @@ public:
   QColor tickLabelColor() const { return mTickLabelColor; }
   double tickLabelRotation() const;
   LabelSide tickLabelSide() const;
+  int tickLabelCacheBudget() const;
+  qint64 tickLabelCacheHits() const;
+  qint64 tickLabelCacheMisses() const;
   QString dateTimeFormat() const { return mDateTimeFormat; }
   Qt::TimeSpec dateTimeSpec() const { return mDateTimeSpec; }
   QString numberFormat() const;
@@ -1164,6 +1207,7 @@ public:
   void setTickLabelColor(const QColor &color);
   void setTickLabelRotation(double degrees);
   void setTickLabelSide(LabelSide side);
+  void setTickLabelCacheBudget(int bytes);
   void setDateTimeFormat(const QString &format);
   void setDateTimeSpec(const Qt::TimeSpec &timeSpec);
   void setNumberFormat(const QString &formatCode);
@@ -1279,6 +1323,10 @@ protected:
   QVector<double> mSubTickVector;
   bool mCachedMarginValid;
   int mCachedMargin;
+  bool mCachedTicksValid;
+  QCPRange mCachedTickRange;
+  QLocale mCachedTickLocale;
+  QMap<double, QString> mTickLabelCache;
   
   // introduced virtual methods:
   virtual void setupTickVectors();
@@ -1296,6 +1344,7 @@ protected:
   
   // non-virtual methods:
   void visibleTickBounds(int &lowIndex, int &highIndex) const;
+  QString tickLabel(double tick) const;
   double baseLog(double value) const;
   double basePow(double value) const;
   QPen getBasePen() const;
@@ -1327,6 +1376,10 @@ public:
   virtual void draw(QCPPainter *painter);
   virtual int size() const;
   void clearCache();
+  int cacheBudget() const { return mLabelCache.maxCost(); }
+  void setCacheBudget(int bytes);
+  qint64 cacheHits() const { return mLabelCacheHits; }
+  qint64 cacheMisses() const { return mLabelCacheMisses; }
   
   QRect axisSelectionBox() const { return mAxisSelectionBox; }
   QRect tickLabelsSelectionBox() const { return mTickLabelsSelectionBox; }
@@ -1372,7 +1425,8 @@ protected:
   };
   QCustomPlot *mParentPlot;
   QByteArray mLabelParameterHash; // to determine whether mLabelCache needs to be cleared due to changed parameters
-  QCache<QString, CachedLabel> mLabelCache;
+  QCache<QString, CachedLabel> mLabelCache; // LRU, the cost of a label is the memory of its pixmap in bytes
+  qint64 mLabelCacheHits, mLabelCacheMisses;
   QRect mAxisSelectionBox, mTickLabelsSelectionBox, mLabelSelectionBox;
   
   virtual QByteArray generateLabelParameterHash() const;
@@ -1814,6 +1868,8 @@ public:
   bool saveRastered(const QString &fileName, int width, int height, double scale, const char *format, int quality=-1);
   QPixmap toPixmap(int width=0, int height=0, double scale=1.0);
   void toPainter(QCPPainter *painter, int width=0, int height=0);
+  void toImageAsync(int width=0, int height=0, double scale=1.0);
+  void saveRasteredAsync(const QString &fileName, int width, int height, double scale, const char *format, int quality=-1);
   Q_SLOT void replot(QCustomPlot::RefreshPriority refreshPriority=QCustomPlot::rpHint);
   
   QCPAxis *xAxis, *yAxis, *xAxis2, *yAxis2;
@@ -1840,6 +1896,8 @@ signals:
   void selectionChangedByUser();
   void beforeReplot();
   void afterReplot();
+  void imageRendered(const QImage &image);
+  void imageSaved(const QString &fileName, bool success);
   
 protected:
   // property members:
@@ -1868,6 +1926,9 @@ protected:
   QPoint mMousePressPos;
   QPointer<QCPLayoutElement> mMouseEventElement;
   bool mReplotting;
+  QList<QRect> mBufferedAxisRectRects;
+  QHash<QCPAxis*, QCPRange> mBufferedAxisRanges;
+  QCP::AntialiasedElements mBufferedAntialiasedElements, mBufferedNotAntialiasedElements;
   
   // reimplemented virtual methods:
   virtual QSize minimumSizeHint() const;
@@ -1887,8 +1948,11 @@ protected:
   
   // non-virtual methods:
   void updateLayerIndices() const;
+  void updateLayerBuffers();
+  void markBufferedLayersDirty();
   QCPLayerable *layerableAt(const QPointF &pos, bool onlySelectable, QVariant *selectionDetails=0) const;
   void drawBackground(QCPPainter *painter);
+  QPicture toPicture(int width, int height, double scale, QSize *imageSize);
   
   friend class QCPLegend;
   friend class QCPAxis;
@@ -1897,6 +1961,29 @@ protected:
 };
 
 
+class QCP_LIB_DECL QCPImageRenderJob : public QObject, public QRunnable
+{
+  Q_OBJECT
+public:
+  QCPImageRenderJob(const QPicture &picture, const QSize &size, double scale, const QString &fileName=QString(), const char *format=0, int quality=-1);
+  
+  // reimplemented virtual methods:
+  virtual void run();
+  
+signals:
+  void rendered(const QImage &image);
+  void saved(const QString &fileName, bool success);
+  
+protected:
+  QPicture mPicture;
+  QSize mSize;
+  double mScale;
+  QString mFileName;
+  QByteArray mFormat;
+  int mQuality;
+};
+
+
 class QCP_LIB_DECL QCPColorGradient
 {
   Q_GADGET
@@ -2475,16 +2562,156 @@ public:
 };
 Q_DECLARE_TYPEINFO(QCPData, Q_MOVABLE_TYPE);
 
+class QCP_LIB_DECL QCPDataContainer
+{
+public:
+  class const_iterator;
+  
+  class iterator
+  {
+  public:
+    iterator() : p(0) {}
+    explicit iterator(QCPData *ptr) : p(ptr) {}
+    
+    const double &key() const { return p->key; }
+    QCPData &value() const { return *p; }
+    QCPData &operator*() const { return *p; }
+    QCPData *operator->() const { return p; }
+    bool operator==(const iterator &other) const { return p == other.p; }
+    bool operator!=(const iterator &other) const { return p != other.p; }
+    bool operator<(const iterator &other) const { return p < other.p; }
+    iterator &operator++() { ++p; return *this; }
+    iterator operator++(int) { iterator r = *this; ++p; return r; }
+    iterator &operator--() { --p; return *this; }
+    iterator operator--(int) { iterator r = *this; --p; return r; }
+    iterator operator+(int j) const { return iterator(p+j); }
+    iterator operator-(int j) const { return iterator(p-j); }
+    iterator &operator+=(int j) { p += j; return *this; }
+    iterator &operator-=(int j) { p -= j; return *this; }
+    int operator-(const iterator &other) const { return int(p-other.p); }
+    
+  private:
+    QCPData *p;
+    friend class const_iterator;
+    friend class QCPDataContainer;
+  };
+  
+  class const_iterator
+  {
+  public:
+    const_iterator() : p(0) {}
+    explicit const_iterator(const QCPData *ptr) : p(ptr) {}
+    const_iterator(const iterator &other) : p(other.p) {}
+    
+    const double &key() const { return p->key; }
+    const QCPData &value() const { return *p; }
+    const QCPData &operator*() const { return *p; }
+    const QCPData *operator->() const { return p; }
+    bool operator==(const const_iterator &other) const { return p == other.p; }
+    bool operator!=(const const_iterator &other) const { return p != other.p; }
+    bool operator<(const const_iterator &other) const { return p < other.p; }
+    const_iterator &operator++() { ++p; return *this; }
+    const_iterator operator++(int) { const_iterator r = *this; ++p; return r; }
+    const_iterator &operator--() { --p; return *this; }
+    const_iterator operator--(int) { const_iterator r = *this; --p; return r; }
+    const_iterator operator+(int j) const { return const_iterator(p+j); }
+    const_iterator operator-(int j) const { return const_iterator(p-j); }
+    const_iterator &operator+=(int j) { p += j; return *this; }
+    const_iterator &operator-=(int j) { p -= j; return *this; }
+    int operator-(const const_iterator &other) const { return int(p-other.p); }
+    
+  private:
+    const QCPData *p;
+  };
+  
+  QCPDataContainer();
+  
+  // getters:
+  int size() const { return mData.size()-mBegin; }
+  int count() const { return size(); }
+  bool isEmpty() const { return size() == 0; }
+  bool contains(double key) const { return constFind(key) != constEnd(); }
+  const QCPData &first() const { return mData.at(mBegin); }
+  const QCPData &last() const { return mData.last(); }
+  double firstKey() const { return first().key; }
+  double lastKey() const { return last().key; }
+  QList<double> keys() const;
+  QList<QCPData> values() const;
+  QCPRange keyRange(bool &foundRange, bool includeErrors=true) const;
+  QCPRange valueRange(bool &foundRange, bool includeErrors=true) const;
+  QCPRange valueRange(const_iterator first, const_iterator last, bool &foundRange) const;
+  void pointsInRect(const QCPRange &keyRange, const QCPRange &valueRange, QVector<QCPData> *points) const;
+  
+  // iterators (the non-const ones allow changing points, so they drop the cached bounds and index):
+  iterator begin() { dropCaches(); return iteratorAt(0); }
+  iterator end() { dropCaches(); return iteratorAt(size()); }
+  const_iterator begin() const { return constBegin(); }
+  const_iterator end() const { return constEnd(); }
+  const_iterator constBegin() const { return const_iterator(mData.constData()+mBegin); }
+  const_iterator constEnd() const { return const_iterator(mData.constData()+mData.size()); }
+  iterator lowerBound(double key) { dropCaches(); return iteratorAt(lowerIndex(key)); }
+  iterator upperBound(double key) { dropCaches(); return iteratorAt(upperIndex(key)); }
+  const_iterator lowerBound(double key) const { return constBegin()+lowerIndex(key); }
+  const_iterator upperBound(double key) const { return constBegin()+upperIndex(key); }
+  iterator find(double key);
+  const_iterator find(double key) const { return constFind(key); }
+  const_iterator constFind(double key) const;
+  
+  // modifiers:
+  void reserve(int size);
+  void clear();
+  iterator insert(double key, const QCPData &data);
+  iterator insertMulti(double key, const QCPData &data);
+  QCPDataContainer &unite(const QCPDataContainer &other);
+  iterator erase(iterator it);
+  iterator erase(iterator first, iterator last);
+  int remove(double key);
+  void removeBefore(double key);
+  void removeAfter(double key);
+  void removeBetween(double fromKey, double toKey);
+  
+protected:
+  QVector<QCPData> mData;
+  int mBegin; // index of the first valid data point, points before were erased from the front
+  // cached bounds of the points with non-NaN value, see keyRange and valueRange:
+  mutable bool mBoundsValid, mBoundsFound;
+  mutable bool mHasKeyErrors, mHasValueErrors;
+  mutable double mValueLower, mValueUpper;
+  mutable double mKeyErrorLower, mKeyErrorUpper, mValueErrorLower, mValueErrorUpper;
+  // value-binned index for pointsInRect, indices into mData in key order per bin (entries before mBegin are stale):
+  mutable QVector<QVector<int> > mValueBins;
+  mutable bool mValueBinsValid;
+  mutable double mValueBinLower, mValueBinUpper, mValueBinWidth;
+  // min/max pyramid of the values, level l holds one range per 16<<l points of mData (NaN if all NaN):
+  mutable QVector<QVector<QCPRange> > mValueLevels;
+  mutable bool mValueLevelsValid;
+  
+  iterator iteratorAt(int index) { return iterator(mData.data()+mBegin+index); }
+  void dropCaches() { mBoundsValid = false; dropIndexes(); }
+  void dropIndexes() const { mValueBinsValid = false; mValueLevelsValid = false; }
+  int lowerIndex(double key) const;
+  int upperIndex(double key) const;
+  int eraseIndices(int from, int to);
+  void compact();
+  void includeInBounds(const QCPData &data) const;
+  bool touchesBounds(int from, int to) const;
+  void updateBounds() const;
+  QCPRange plainKeyRange(bool &foundRange) const;
+  void buildValueBins() const;
+  void addToValueBins(int index) const;
+  void buildValueLevels() const;
+  void addToValueLevels(int index) const;
+};
+
 /*! \typedef QCPDataMap
-  Container for storing \ref QCPData items in a sorted fashion. The key of the map
-  is the key member of the QCPData instance.
+  Container for storing \ref QCPData items in a sorted fashion. The key is the key member of
+  the QCPData instance.
   
-  This is the container in which QCPGraph holds its data.
+  This is the container in which QCPGraph holds its data. It used to be a QMap<double, QCPData>
+  and is now a \ref QCPDataContainer, which offers the same (QMap style) interface.
   \see QCPData, QCPGraph::setData
 */
-typedef QMap<double, QCPData> QCPDataMap;
-typedef QMapIterator<double, QCPData> QCPDataMapIterator;
-typedef QMutableMapIterator<double, QCPData> QCPDataMutableMapIterator;
+typedef QCPDataContainer QCPDataMap;
 
 
 class QCP_LIB_DECL QCPGraph : public QCPAbstractPlottable
@@ -2589,6 +2816,10 @@ protected:
   QPointer<QCPGraph> mChannelFillGraph;
   bool mAdaptiveSampling;
   
+  // non-property members:
+  mutable QPixmap mScatterSprite;
+  mutable QByteArray mScatterSpriteKey;
+  
   // reimplemented virtual methods:
   virtual void draw(QCPPainter *painter);
   virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const;
@@ -2625,6 +2856,8 @@ protected:
   int findIndexBelowY(const QVector<QPointF> *data, double y) const;
   int findIndexAboveY(const QVector<QPointF> *data, double y) const;
   double pointDistance(const QPointF &pixelPoint) const;
+  void getNeighbourhoodLineData(const QCPRange &keyRange, QVector<QPointF> *linePixelData) const;
+  bool updateScatterSprite(QCPPainter *painter) const;
   
   friend class QCustomPlot;
   friend class QCPLegend;
@@ -0,0 +1,31 @@
+#-------------------------------------------------
+#
+# atlaslog: command line converter for AtlasTerminal logs
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = atlaslog
+TEMPLATE = app
+CONFIG   += console c++11
+CONFIG   -= app_bundle
+
+INCLUDEPATH += ../../src
+
+SOURCES += \
+    main.cpp \
+    logconverter.cpp \
+    ../../src/logstore.cpp \
+    ../../src/logmanifest.cpp \
+    ../../src/binlog.cpp \
+    ../../src/lineformatter.cpp
+
+HEADERS += \
+    logconverter.h \
+    ../../src/atlasreading.h \
+    ../../src/logstore.h \
+    ../../src/logmanifest.h \
+    ../../src/binlog.h \
+    ../../src/lineformatter.h
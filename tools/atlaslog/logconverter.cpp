@@ -0,0 +1,248 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include "logconverter.h"
+#include "logstore.h"
+#include <QtNumeric>
+#include <cstdio>
+
+LogConverter::LogConverter(const QString &input, const QString &output, const ConvertOptions &options) :
+    input(input),
+    output(output),
+    options(options)
+{
+
+}
+
+void LogConverter::run()
+{
+    if (convert()) {
+        std::fprintf(stderr, "%s -> %s: %lld lines\n", qPrintable(input), qPrintable(output), (long long)written);
+    } else {
+        std::fprintf(stderr, "%s: %s\n", qPrintable(input), qPrintable(error));
+    }
+}
+
+/**
+ * @brief Convert the input log, two passes: columns first, then the readings.
+ */
+bool LogConverter::convert()
+{
+    LogStore store(input);
+    if (!store.isValid()) {
+        error = "cannot open log";
+        return false;
+    }
+    if (!collectColumns()) return false;
+
+    file.setFileName(output);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        error = "cannot create " + output + ": " + file.errorString();
+        return false;
+    }
+    if (options.format == ConvertOptions::fmtBinary) {
+        if (!binWriter.open(&file, columns)) {
+            error = QString("binary logs hold at most %1 stamps").arg(int(BinLogHeader::kMaxColumns));
+            return false;
+        }
+        values.resize(columns.size());
+    } else {
+        batch.append(header().toUtf8()).append('\n');
+    }
+
+    sums.fill(0.0, columns.size());
+    counts.fill(0, columns.size());
+    deltas.fill(0, columns.size());
+    pending = false;
+
+    store.scan(options.fromMs, options.toMs, [this](const AtlasReading &r) {
+        if (accepted(r)) add(r);
+        return true;
+    });
+    if (pending) writeTick();
+
+    if (options.format == ConvertOptions::fmtBinary) {
+        binWriter.commit();
+    } else {
+        file.write(batch);
+        batch.clear();
+    }
+    file.close();
+    return true;
+}
+
+/**
+ * @brief First pass: the stamps (and their probe types) of the output.
+ *
+ * Wide CSV logs number their columns from stamp 0, so the wide format
+ * keeps a column for every stamp up to the highest one.
+ */
+bool LogConverter::collectColumns()
+{
+    QVector<int> channels;
+    LogStore(input).scan(options.fromMs, options.toMs, [this, &channels](const AtlasReading &r) {
+        if (!accepted(r)) return true;
+        if (r.stampId >= channels.size()) channels.resize(r.stampId + 1);
+        if (channels.at(r.stampId) == 0) channels[r.stampId] = r.channel + 1;
+        return true;
+    });
+
+    columns.clear();
+    columnOf.fill(-1, channels.size());
+    for (int id = 0; id < channels.size(); ++id) {
+        if (channels.at(id) == 0 && options.format != ConvertOptions::fmtWide) continue;
+        BinLogColumn col;
+        col.stampId = quint16(id);
+        col.channel = quint16(qMax(channels.at(id) - 1, 0));
+        columnOf[id] = columns.size();
+        columns.append(col);
+    }
+
+    if (columns.isEmpty()) {
+        error = "no readings in the selected range";
+        return false;
+    }
+    if (options.format == ConvertOptions::fmtCsv && columns.size() > 1) {
+        error = QString("%1 stamps in the log, select one with --stamp or use --format wide").arg(columns.size());
+        return false;
+    }
+    return true;
+}
+
+bool LogConverter::accepted(const AtlasReading &r) const
+{
+    return options.stamps.isEmpty() || options.stamps.contains(r.stampId);
+}
+
+/**
+ * @brief Add a reading to the current tick; a reading of a later tick writes the current one.
+ *
+ * Logs are in time order, so a tick is complete when the next one starts.
+ */
+void LogConverter::add(const AtlasReading &r)
+{
+    qint64 t = r.timeMs;
+    if (options.resampleMs > 0) {
+        t -= t % options.resampleMs;
+        if (r.timeMs < 0 && t != r.timeMs) t -= options.resampleMs;
+    }
+    if (pending && t != tickMs) writeTick();
+
+    tickMs = t;
+    pending = true;
+    int c = columnOf.at(r.stampId);
+    sums[c] += r.value;
+    ++counts[c];
+    deltas[c] = r.deltaMs;
+}
+
+/**
+ * @brief Write the current tick: the mean of each stamp's readings in the tick.
+ */
+void LogConverter::writeTick()
+{
+    switch (options.format) {
+    case ConvertOptions::fmtBinary:
+        for (int c = 0; c < columns.size(); ++c) {
+            values[c] = counts.at(c) > 0 ? sums.at(c)/counts.at(c) : qQNaN();
+        }
+        binWriter.append(tickMs, values.constData());
+        if (written % 4096 == 4095) binWriter.commit();
+        break;
+    case ConvertOptions::fmtWide:
+        fmt.appendTimestamp(batch, tickMs, true);
+        for (int c = 0; c < columns.size(); ++c) {
+            if (counts.at(c) == 0) {
+                batch.append(", , ");
+            } else {
+                batch.append(", ");
+                fmt.appendValue(batch, sums.at(c)/counts.at(c), columns.at(c).channel);
+                batch.append(", ");
+                fmt.appendInt(batch, deltas.at(c));
+            }
+        }
+        batch.append('\n');
+        break;
+    default:
+        fmt.appendTimestamp(batch, tickMs);
+        batch.append(", ");
+        fmt.appendValue(batch, sums.at(0)/counts.at(0), columns.at(0).channel);
+        batch.append('\n');
+        break;
+    }
+    if (batch.size() >= 64*1024) {
+        file.write(batch);
+        batch.clear();
+    }
+
+    sums.fill(0.0);
+    counts.fill(0);
+    deltas.fill(0);
+    pending = false;
+    ++written;
+}
+
+/**
+ * @brief Header line as written by AtlasTerminal for the same format.
+ */
+QString LogConverter::header() const
+{
+    if (options.format == ConvertOptions::fmtCsv) {
+        return "# unixTime, yyyy-MM-dd, hh:mm:ss, " + LogStore::channelName(columns.first().channel);
+    }
+    QString h = "# unixTime, yyyy-MM-dd, hh:mm:ss.zzz";
+    for (int c = 0; c < columns.size(); ++c) {
+        h += QString(", value%1, dt%1_ms").arg(columns.at(c).stampId);
+    }
+    return h;
+}
+
+QString LogConverter::suffixFor(int format)
+{
+    return format == ConvertOptions::fmtBinary ? ".alb" : ".log";
+}
+
+QString LogConverter::getInput() const
+{
+    return input;
+}
+
+QString LogConverter::getOutput() const
+{
+    return output;
+}
+
+QString LogConverter::getError() const
+{
+    return error;
+}
+
+qint64 LogConverter::getWritten() const
+{
+    return written;
+}
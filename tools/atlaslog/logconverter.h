@@ -0,0 +1,103 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#ifndef LOGCONVERTER_H
+#define LOGCONVERTER_H
+
+#include <QRunnable>
+#include <QString>
+#include <QList>
+#include <QFile>
+#include <QVector>
+#include <QByteArray>
+#include <limits>
+
+#include "atlasreading.h"
+#include "binlog.h"
+#include "lineformatter.h"
+
+/** @brief What to convert, shared by all input files. */
+struct ConvertOptions {
+    enum Format { fmtCsv, fmtBinary, fmtWide };
+
+    int format = fmtCsv;        /**< csv: one stamp per line, wide: one column pair per stamp */
+    qint64 fromMs = std::numeric_limits<qint64>::min();
+    qint64 toMs = std::numeric_limits<qint64>::max();
+    QList<int> stamps;          /**< stamps to keep, empty: all */
+    qint64 resampleMs = 0;      /**< average over intervals of this length, 0: keep all readings */
+    };
+
+/** @brief Streams one log (CSV, binary or rotated) into one output log.
+ *
+ * Readings are read with LogStore::scan() and written tick by tick, so
+ * memory use does not depend on the size of the log. Runs on a QThreadPool.
+*/
+class LogConverter : public QRunnable
+{
+public:
+    LogConverter(const QString &input, const QString &output, const ConvertOptions &options);
+
+    void run();
+    bool convert();
+
+    QString getInput() const;
+    QString getOutput() const;
+    QString getError() const;
+    qint64 getWritten() const;
+
+    static QString suffixFor(int format);
+
+private:
+    bool collectColumns();
+    bool accepted(const AtlasReading &r) const;
+    void add(const AtlasReading &r);
+    void writeTick();
+    QString header() const;
+
+    QString input;
+    QString output;
+    ConvertOptions options;
+    QString error;
+    qint64 written = 0;         /**< ticks written */
+
+    QVector<BinLogColumn> columns;
+    QVector<int> columnOf;      /**< stampId -> column, -1: not in the output */
+    QVector<double> sums;       /**< per column, readings of the current tick */
+    QVector<int> counts;
+    QVector<qint32> deltas;
+    qint64 tickMs = 0;
+    bool pending = false;
+
+    QFile file;
+    QByteArray batch;           /**< CSV lines not yet written */
+    QVector<double> values;
+    BinLogWriter binWriter;
+    LineFormatter fmt;
+};
+
+#endif // LOGCONVERTER_H
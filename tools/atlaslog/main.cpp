@@ -0,0 +1,160 @@
+/***************************************************************************
+**
+**  This file is part of AtlasTerminal, a host computer GUI for
+**  Atlas Scientific(TM) stamps
+**  connected via an Atlas Scientific USB EZO(TM) Carrier Board
+**  Copyright (C) 2016-2018 Paul JM van Kan
+**
+**  AtlasTerminal is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+
+**  AtlasTerminal is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+
+**  You should have received a copy of the GNU General Public License
+**  along with AtlasTerminal.  If not, see <http://www.gnu.org/licenses/>.
+
+***************************************************************************
+**           Author: Paul JM van Kan                                     **
+**  Website/Contact:                                                     **
+**             Date:                                                     **
+**          Version:                                                     **
+***************************************************************************/
+
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QThreadPool>
+#include <QThread>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QDir>
+#include <cstdio>
+
+#include "logconverter.h"
+
+// QString::SkipEmptyParts is deprecated since Qt 5.14
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+static const Qt::SplitBehavior skipEmptyParts = Qt::SkipEmptyParts;
+#else
+static const QString::SplitBehavior skipEmptyParts = QString::SkipEmptyParts;
+#endif
+
+/**
+ * @brief Time option: seconds since epoch, or local time "yyyy-MM-ddThh:mm:ss".
+ */
+static bool parseTime(const QString &text, qint64 &timeMs)
+{
+    bool ok;
+    qint64 secs = text.toLongLong(&ok);
+    if (ok) {
+        timeMs = secs*1000;
+        return true;
+    }
+    QDateTime dt = QDateTime::fromString(text, Qt::ISODate);
+    if (!dt.isValid()) return false;
+    timeMs = dt.toMSecsSinceEpoch();
+    return true;
+}
+
+static int fail(const QString &message)
+{
+    std::fprintf(stderr, "atlaslog: %s\n", qPrintable(message));
+    return 1;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QCoreApplication::setApplicationName("atlaslog");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Convert, filter and resample AtlasTerminal logs (CSV, binary, rotated).");
+    parser.addHelpOption();
+    parser.addPositionalArgument("logs", "Log files, binary logs or manifests of rotated logs.", "logs...");
+    QCommandLineOption formatOption(QStringList() << "f" << "format",
+        "Output format: csv (one stamp), wide (one column pair per stamp) or binary.", "format", "csv");
+    QCommandLineOption outputOption(QStringList() << "o" << "output",
+        "Output file for a single log, else output directory (default: current directory).", "path");
+    QCommandLineOption fromOption("from", "First time: seconds since epoch or yyyy-MM-ddThh:mm:ss.", "time");
+    QCommandLineOption toOption("to", "Last time: seconds since epoch or yyyy-MM-ddThh:mm:ss.", "time");
+    QCommandLineOption stampOption(QStringList() << "s" << "stamp",
+        "Keep only this stamp; may be repeated or comma separated.", "id");
+    QCommandLineOption resampleOption(QStringList() << "r" << "resample",
+        "Average the readings over intervals of this many ms.", "ms");
+    QCommandLineOption jobsOption(QStringList() << "j" << "jobs",
+        "Number of logs converted in parallel.", "n", QString::number(QThread::idealThreadCount()));
+    parser.addOption(formatOption);
+    parser.addOption(outputOption);
+    parser.addOption(fromOption);
+    parser.addOption(toOption);
+    parser.addOption(stampOption);
+    parser.addOption(resampleOption);
+    parser.addOption(jobsOption);
+    parser.process(a);
+
+    QStringList inputs = parser.positionalArguments();
+    if (inputs.isEmpty()) parser.showHelp(1);
+
+    ConvertOptions options;
+    QString format = parser.value(formatOption);
+    if (format == "csv") options.format = ConvertOptions::fmtCsv;
+    else if (format == "wide") options.format = ConvertOptions::fmtWide;
+    else if (format == "binary") options.format = ConvertOptions::fmtBinary;
+    else return fail("unknown format " + format);
+
+    if (parser.isSet(fromOption) && !parseTime(parser.value(fromOption), options.fromMs)) {
+        return fail("invalid time " + parser.value(fromOption));
+    }
+    if (parser.isSet(toOption) && !parseTime(parser.value(toOption), options.toMs)) {
+        return fail("invalid time " + parser.value(toOption));
+    }
+    foreach (const QString &list, parser.values(stampOption)) {
+        foreach (const QString &id, list.split(',', skipEmptyParts)) {
+            bool ok;
+            int stamp = id.trimmed().toInt(&ok);
+            if (!ok || stamp < 0 || stamp > 0xffff) return fail("invalid stamp " + id);
+            options.stamps.append(stamp);
+        }
+    }
+    if (parser.isSet(resampleOption)) {
+        bool ok;
+        options.resampleMs = parser.value(resampleOption).toLongLong(&ok);
+        if (!ok || options.resampleMs <= 0) return fail("invalid interval " + parser.value(resampleOption));
+    }
+
+    // -o is the output file for one log without a directory of that name, else a directory
+    QString out = parser.value(outputOption);
+    bool toFile = inputs.size() == 1 && !out.isEmpty() && !QFileInfo(out).isDir();
+    QDir outDir(out.isEmpty() ? QString(".") : out);
+    if (!toFile && !outDir.mkpath(".")) return fail("cannot create " + out);
+
+    QList<LogConverter*> jobs;
+    foreach (const QString &input, inputs) {
+        QString name = QFileInfo(input).completeBaseName() + LogConverter::suffixFor(options.format);
+        QString output = toFile ? out : outDir.absoluteFilePath(name);
+        if (QFileInfo(output).absoluteFilePath() == QFileInfo(input).absoluteFilePath()) {
+            return fail(input + " would be overwritten, use -o");
+        }
+        LogConverter *job = new LogConverter(input, output, options);
+        job->setAutoDelete(false);
+        jobs.append(job);
+    }
+
+    // one log per thread; each job streams its log, memory does not grow with the log size
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, parser.value(jobsOption).toInt()));
+    foreach (LogConverter *job, jobs) pool.start(job);
+    pool.waitForDone();
+
+    int failed = 0;
+    foreach (LogConverter *job, jobs) {
+        if (!job->getError().isEmpty()) ++failed;
+        delete job;
+    }
+    return failed > 0 ? 1 : 0;
+}